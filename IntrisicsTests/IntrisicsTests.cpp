@@ -1,112 +1,1987 @@
 #include <iostream>
 #include <intrin.h>
 #include <vector>
+#include <array>
 #include <algorithm>
 #include <random>
 #include <chrono>
 #include <fstream>
+#include <thread>
+#include <stdexcept>
+#include <utility>
+#include <optional>
+#include <atomic>
+#include <string>
+#include <cstdio>
+#include <filesystem>
+
+#include "mapped_file.h"
+#include "parallel.h"
+#include "test_data.h"
 
 using namespace std;
 
-namespace testData {
-  vector<uint64_t> missedNumber(uint64_t n, uint64_t t) {
-    vector<uint64_t> res(n - 1);
+namespace testData {
+  /**
+  * 0..n-1 without t, shuffled. Same seed gives the same data
+  * for any number of threads.
+  */
+  vector<uint64_t> missedNumber(
+    uint64_t n, 
+    uint64_t t, 
+    uint64_t seed = DEFAULT_SEED, 
+    unsigned threads = 0) {
+    vector<uint64_t> res(n - 1);
+
+    parallelFill(res.data(), res.size(), [t](size_t i) {
+      return i < t ? (uint64_t)i : (uint64_t)i + 1;
+    }, threads);
+
+    testData::shuffle(res, seed, threads);
+    return res;
+  }
+
+  /**
+  * Sequence numbers 0..n-1 as they arrive: every value is dropped 
+  * with probability loss, the rest are reordered within blocks of
+  * reorder values. Dropped values go to lost, ascending.
+  */
+  vector<uint64_t> sequenceStream(
+    uint64_t n, 
+    double loss, 
+    size_t reorder, 
+    vector<uint64_t>& lost,
+    uint64_t seed = DEFAULT_SEED) {
+    Stream drops(seed, 0);
+
+    vector<uint64_t> res;
+    res.reserve(n);
+    lost.clear();
+
+    for (uint64_t i = 0; i < n; ++i) {
+      if (drops.uniform() < loss) {
+        lost.push_back(i);
+      }
+      else {
+        res.push_back(i);
+      }
+    }
+
+    for (size_t i = 0; i < res.size(); i += reorder) {
+      Stream urng(seed, i / reorder + 1);
+      std::shuffle(res.begin() + i, res.begin() + std::min(res.size(), i + reorder), urng);
+    }
+
+    return res;
+  }
+}
+
+
+
+/**
+* Reduction of uint64 arrays with a binary operation.
+* Unaligned loads only, 4 independent accumulators per ISA to hide
+* operation latency, ISA is chosen at runtime once.
+* Op provides identity and apply() for uint64_t, __m128i, __m256i
+* and __m512i, see Xor.
+*/
+namespace reduction {
+  enum class Isa {
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512
+  };
+
+  const char* isaName(Isa isa) {
+    switch (isa) {
+    case Isa::Avx512: return "AVX-512";
+    case Isa::Avx2: return "AVX2";
+    case Isa::Sse2: return "SSE2";
+    default: return "scalar";
+    }
+  }
+
+  Isa detectIsa() {
+    int info[4];
+    __cpuid(info, 0);
+    int leaves = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = info[3] & (1 << 26);
+    bool osxsave = info[2] & (1 << 27);
+
+    bool avx2 = false;
+    bool avx512 = false;
+
+    if (leaves >= 7) {
+      __cpuidex(info, 7, 0);
+      avx2 = info[1] & (1 << 5);
+      // F and DQ (64-bit mullo)
+      avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 17));
+    }
+
+    // registers must be also saved by OS
+    uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+
+    if (avx512 && (xcr0 & 0xE6) == 0xE6) {
+      return Isa::Avx512;
+    }
+    if (avx2 && (xcr0 & 0x6) == 0x6) {
+      return Isa::Avx2;
+    }
+    return sse2 ? Isa::Sse2 : Isa::Scalar;
+  }
+
+  Isa activeIsa() {
+    static const Isa isa = detectIsa();
+    return isa;
+  }
+
+  struct Xor {
+    static constexpr uint64_t identity = 0;
+
+    static uint64_t apply(uint64_t a, uint64_t b) { return a ^ b; }
+    static __m128i apply(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+    static __m256i apply(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+    static __m512i apply(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+  };
+
+  struct Sum {
+    static constexpr uint64_t identity = 0;
+
+    static uint64_t apply(uint64_t a, uint64_t b) { return a + b; }
+    static __m128i apply(__m128i a, __m128i b) { return _mm_add_epi64(a, b); }
+    static __m256i apply(__m256i a, __m256i b) { return _mm256_add_epi64(a, b); }
+    static __m512i apply(__m512i a, __m512i b) { return _mm512_add_epi64(a, b); }
+  };
+
+  // fold lanes of a spilled register
+  template <typename Op, size_t Lanes>
+  uint64_t fold(const uint64_t (&lanes)[Lanes], uint64_t res) {
+    for (auto l : lanes) {
+      res = Op::apply(res, l);
+    }
+    return res;
+  }
+
+  template <typename Op>
+  uint64_t reduceScalar(const uint64_t* it, size_t n) {
+    uint64_t a0 = Op::identity, a1 = Op::identity;
+    uint64_t a2 = Op::identity, a3 = Op::identity;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+      a0 = Op::apply(a0, it[i]);
+      a1 = Op::apply(a1, it[i + 1]);
+      a2 = Op::apply(a2, it[i + 2]);
+      a3 = Op::apply(a3, it[i + 3]);
+    }
+
+    for (; i < n; ++i) {
+      a0 = Op::apply(a0, it[i]);
+    }
+
+    return Op::apply(Op::apply(a0, a1), Op::apply(a2, a3));
+  }
+
+  template <typename Op>
+  uint64_t reduceSse2(const uint64_t* it, size_t n) {
+    auto id = _mm_set1_epi64x(Op::identity);
+    auto a0 = id, a1 = id, a2 = id, a3 = id;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+      a0 = Op::apply(a0, _mm_loadu_si128((const __m128i*)(it + i)));
+      a1 = Op::apply(a1, _mm_loadu_si128((const __m128i*)(it + i + 2)));
+      a2 = Op::apply(a2, _mm_loadu_si128((const __m128i*)(it + i + 4)));
+      a3 = Op::apply(a3, _mm_loadu_si128((const __m128i*)(it + i + 6)));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, Op::apply(Op::apply(a0, a1), Op::apply(a2, a3)));
+
+    return fold<Op>(lanes, reduceScalar<Op>(it + i, n - i));
+  }
+
+  template <typename Op>
+  uint64_t reduceAvx2(const uint64_t* it, size_t n) {
+    auto id = _mm256_set1_epi64x(Op::identity);
+    auto a0 = id, a1 = id, a2 = id, a3 = id;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+      a0 = Op::apply(a0, _mm256_loadu_si256((const __m256i*)(it + i)));
+      a1 = Op::apply(a1, _mm256_loadu_si256((const __m256i*)(it + i + 4)));
+      a2 = Op::apply(a2, _mm256_loadu_si256((const __m256i*)(it + i + 8)));
+      a3 = Op::apply(a3, _mm256_loadu_si256((const __m256i*)(it + i + 12)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, Op::apply(Op::apply(a0, a1), Op::apply(a2, a3)));
+
+    return fold<Op>(lanes, reduceScalar<Op>(it + i, n - i));
+  }
+
+  template <typename Op>
+  uint64_t reduceAvx512(const uint64_t* it, size_t n) {
+    auto id = _mm512_set1_epi64(Op::identity);
+    auto a0 = id, a1 = id, a2 = id, a3 = id;
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+      a0 = Op::apply(a0, _mm512_loadu_si512(it + i));
+      a1 = Op::apply(a1, _mm512_loadu_si512(it + i + 8));
+      a2 = Op::apply(a2, _mm512_loadu_si512(it + i + 16));
+      a3 = Op::apply(a3, _mm512_loadu_si512(it + i + 24));
+    }
+
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, Op::apply(Op::apply(a0, a1), Op::apply(a2, a3)));
+
+    return fold<Op>(lanes, reduceScalar<Op>(it + i, n - i));
+  }
+
+  template <typename Op>
+  uint64_t reduce(const uint64_t* it, size_t n, Isa isa = activeIsa()) {
+    switch (isa) {
+    case Isa::Avx512: return reduceAvx512<Op>(it, n);
+    case Isa::Avx2: return reduceAvx2<Op>(it, n);
+    case Isa::Sse2: return reduceSse2<Op>(it, n);
+    default: return reduceScalar<Op>(it, n);
+    }
+  }
+
+  // a thread gets at least 8 MB, below that one core saturates 
+  // its share of bandwidth anyway
+  constexpr size_t PARALLEL_PART = 1 << 20;
+
+  template <typename Op>
+  uint64_t reduceParallel(const uint64_t* it, size_t n, unsigned threads = 0) {
+    threads = parallel::threadsFor(n, PARALLEL_PART, threads);
+
+    if (threads < 2) {
+      return reduce<Op>(it, n);
+    }
+
+    vector<uint64_t> partial(threads, Op::identity);
+
+    parallel::split(n, threads, [&](unsigned t, size_t begin, size_t end) {
+      partial[t] = reduce<Op>(it + begin, end - begin);
+    }, 8);
+
+    return reduceScalar<Op>(partial.data(), partial.size());
+  }
+}
+
+
+/**
+* XOR of 0..n-1. XOR of 4k..4k+3 is 0, so only the last
+* incomplete four matters: n - 1, 1, n, 0 for (n - 1) % 4 = 0..3
+*/
+constexpr uint64_t getInintialConstant(uint64_t n) {
+  if (n == 0) {
+    return 0;
+  }
+
+  switch ((n - 1) & 3) {
+  case 0: return n - 1;
+  case 1: return 1;
+  case 2: return n;
+  default: return 0;
+  }
+}
+
+static_assert(getInintialConstant(0) == 0 && getInintialConstant(1) == 0);
+static_assert(getInintialConstant(2) == 1 && getInintialConstant(3) == 3);
+static_assert(getInintialConstant(4) == 0 && getInintialConstant(7) == 7);
+static_assert(getInintialConstant(1ull << 32) == 0);
+
+
+uint64_t findMissed(const vector<uint64_t>& v) {
+  uint64_t res = getInintialConstant(v.size() + 1);
+
+  for (const auto& i : v) {
+    res ^= i;
+  }
+
+  return res;
+}
+
+/**
+* Size is known at compile time, so is the constant
+*/
+template <size_t N>
+uint64_t findMissed(const array<uint64_t, N>& v) {
+  constexpr uint64_t initial = getInintialConstant(N + 1);
+  return initial ^ reduction::reduce<reduction::Xor>(v.data(), N);
+}
+
+// single thread, widest ISA available
+uint64_t findMissedOptimized(const vector<uint64_t>& v) {
+  if (v.size() < 100) {
+    return findMissed(v);
+  }
+
+  return getInintialConstant(v.size() + 1) ^ 
+    reduction::reduce<reduction::Xor>(v.data(), v.size());
+}
+
+
+uint64_t findMissedOptimized2(const vector<uint64_t>& v, unsigned threads = 0) {
+  if (v.size() < 100) {
+    return findMissed(v);
+  }
+
+  return getInintialConstant(v.size() + 1) ^ 
+    reduction::reduceParallel<reduction::Xor>(v.data(), v.size(), threads);
+}
+
+
+/**
+* Arithmetic modulo Mersenne prime 2^31 - 1 and polynomials over it,
+* for findMissingK. Products of two values below 2^32 fit uint64,
+* so SIMD can use _mm512_mul_epu32.
+* Polynomials are coefficient vectors, lowest degree first.
+*/
+namespace primeField {
+  constexpr uint64_t P = (1ull << 31) - 1;
+
+  using Poly = vector<uint64_t>;
+
+  // any v < 2^64 to below 2^31 + 5, two folds of 2^31 = 1
+  inline uint64_t fold(uint64_t v) {
+    v = (v & P) + (v >> 31);
+    return (v & P) + (v >> 31);
+  }
+
+  inline uint64_t reduce(uint64_t v) {
+    v = fold(v);
+    return v >= P ? v - P : v;
+  }
+
+  inline uint64_t mul(uint64_t a, uint64_t b) {
+    return reduce(a * b);
+  }
+
+  inline uint64_t add(uint64_t a, uint64_t b) {
+    return reduce(a + b);
+  }
+
+  inline uint64_t sub(uint64_t a, uint64_t b) {
+    return reduce(a + P - b);
+  }
+
+  uint64_t pow(uint64_t a, uint64_t e) {
+    uint64_t res = 1;
+    for (; e; e >>= 1) {
+      if (e & 1) {
+        res = mul(res, a);
+      }
+      a = mul(a, a);
+    }
+    return res;
+  }
+
+  uint64_t inverse(uint64_t a) {
+    return pow(a, P - 2);
+  }
+
+  void trim(Poly& a) {
+    while (!a.empty() && a.back() == 0) {
+      a.pop_back();
+    }
+  }
+
+  // remainder of a / m, m is monic
+  void modMonic(Poly& a, const Poly& m) {
+    auto dm = m.size() - 1;
+    for (size_t i = a.size(); i-- > dm;) {
+      auto c = a[i];
+      if (c == 0) {
+        continue;
+      }
+      for (size_t j = 0; j <= dm; ++j) {
+        a[i - dm + j] = sub(a[i - dm + j], mul(c, m[j]));
+      }
+    }
+    a.resize(std::min(a.size(), dm));
+    trim(a);
+  }
+
+  Poly mulMod(const Poly& a, const Poly& b, const Poly& m) {
+    if (a.empty() || b.empty()) {
+      return {};
+    }
+
+    Poly res(a.size() + b.size() - 1, 0);
+    for (size_t i = 0; i < a.size(); ++i) {
+      for (size_t j = 0; j < b.size(); ++j) {
+        res[i + j] = add(res[i + j], mul(a[i], b[j]));
+      }
+    }
+
+    modMonic(res, m);
+    return res;
+  }
+
+  Poly powMod(Poly base, uint64_t e, const Poly& m) {
+    Poly res{ 1 };
+    modMonic(base, m);
+
+    for (; e; e >>= 1) {
+      if (e & 1) {
+        res = mulMod(res, base, m);
+      }
+      base = mulMod(base, base, m);
+    }
+    return res;
+  }
+
+  void makeMonic(Poly& a) {
+    auto inv = inverse(a.back());
+    for (auto& c : a) {
+      c = mul(c, inv);
+    }
+  }
+
+  Poly gcd(Poly a, Poly b) {
+    trim(a);
+    trim(b);
+    while (!b.empty()) {
+      makeMonic(b);
+      modMonic(a, b);
+      std::swap(a, b);
+    }
+    if (!a.empty()) {
+      makeMonic(a);
+    }
+    return a;
+  }
+
+  // quotient of a / m, m is monic and divides a
+  Poly divMonic(Poly a, const Poly& m) {
+    auto dm = m.size() - 1;
+    Poly q(a.size() - dm, 0);
+    for (size_t i = a.size(); i-- > dm;) {
+      auto c = a[i];
+      q[i - dm] = c;
+      for (size_t j = 0; j <= dm; ++j) {
+        a[i - dm + j] = sub(a[i - dm + j], mul(c, m[j]));
+      }
+    }
+    return q;
+  }
+
+  /**
+  * Roots of monic f, which splits into distinct linear factors.
+  * Cantor-Zassenhaus: gcd(f, (x + a)^((P - 1) / 2) - 1) takes
+  * about half of the roots for every shift a.
+  */
+  void roots(const Poly& f, vector<uint64_t>& res) {
+    if (f.size() < 2) {
+      return;
+    }
+    if (f.size() == 2) {
+      res.push_back(sub(0, f[0]));
+      return;
+    }
+
+    for (uint64_t a = 1;; ++a) {
+      auto h = powMod(Poly{ a, 1 }, (P - 1) / 2, f);
+      if (h.empty()) {
+        h.push_back(0);
+      }
+      h[0] = sub(h[0], 1);
+
+      auto g = gcd(f, h);
+      if (g.size() > 1 && g.size() < f.size()) {
+        roots(g, res);
+        roots(divMonic(f, g), res);
+        return;
+      }
+    }
+  }
+}
+
+
+namespace missingK {
+  using namespace primeField;
+
+  constexpr size_t MAX_K = 32;
+
+  // sum of x^j for j = 1..K, reduced mod P
+  template <size_t K>
+  void powerSumsScalar(const uint64_t* it, size_t n, uint64_t* sums) {
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t x = it[i];
+      uint64_t pw = x;
+      sums[0] += x;
+      for (size_t j = 1; j < K; ++j) {
+        pw = fold(pw * x);
+        sums[j] += pw;
+      }
+    }
+  }
+
+  // product of lanes below 2^32, two lazy folds keep it below 2^32
+  inline __m512i mulLazy(__m512i a, __m512i b) {
+    const auto mask = _mm512_set1_epi64(P);
+
+    auto t = _mm512_mul_epu32(a, b);
+    t = _mm512_add_epi64(_mm512_and_si512(t, mask), _mm512_srli_epi64(t, 31));
+    return _mm512_add_epi64(_mm512_and_si512(t, mask), _mm512_srli_epi64(t, 31));
+  }
+
+  /**
+  * Accumulators per group: 16 of them plus x, power and fold mask
+  * fit in the 32 zmm registers. Larger K takes several groups over
+  * the same L1 resident chunk, a group leaves its last power in
+  * carry and the next one continues from there.
+  */
+  constexpr size_t GROUP = 16;
+  constexpr size_t GROUP_CHUNK = 1024;
+
+  // sums of x^(First + 1) .. x^(First + Count) over n, n multiple of 8
+  template <size_t First, size_t Count, bool Last>
+  void powerSumsGroup(const uint64_t* it, size_t n, __m512i* total, uint64_t* carry) {
+    __m512i acc[Count];
+    for (size_t j = 0; j < Count; ++j) {
+      acc[j] = total[First + j];
+    }
+
+    for (size_t i = 0; i < n; i += 8) {
+      auto x = _mm512_loadu_si512(it + i);
+
+      __m512i pw;
+      if constexpr (First == 0) {
+        pw = x;
+      }
+      else {
+        pw = mulLazy(_mm512_load_si512(carry + i), x);
+      }
+      acc[0] = _mm512_add_epi64(acc[0], pw);
+
+      for (size_t j = 1; j < Count; ++j) {
+        pw = mulLazy(pw, x);
+        acc[j] = _mm512_add_epi64(acc[j], pw);
+      }
+
+      if constexpr (!Last) {
+        _mm512_store_si512(carry + i, pw);
+      }
+    }
+
+    for (size_t j = 0; j < Count; ++j) {
+      total[First + j] = acc[j];
+    }
+  }
+
+  template <size_t K, size_t First = 0>
+  void powerSumsGroups(const uint64_t* it, size_t n, __m512i* total, uint64_t* carry) {
+    if constexpr (First < K) {
+      constexpr size_t count = std::min(GROUP, K - First);
+      powerSumsGroup<First, count, First + count == K>(it, n, total, carry);
+      powerSumsGroups<K, First + GROUP>(it, n, total, carry);
+    }
+  }
+
+  template <size_t K>
+  void powerSumsAvx512(const uint64_t* it, size_t n, uint64_t* sums) {
+    // in memory, touched once per chunk and group
+    __m512i total[K];
+    for (auto& t : total) {
+      t = _mm512_setzero_si512();
+    }
+
+    alignas(64) uint64_t carry[GROUP_CHUNK];
+
+    const size_t vectors = n / 8 * 8;
+    for (size_t i = 0; i < vectors; i += GROUP_CHUNK) {
+      powerSumsGroups<K>(it + i, std::min(GROUP_CHUNK, vectors - i), total, carry);
+    }
+
+    for (size_t j = 0; j < K; ++j) {
+      uint64_t lanes[8];
+      _mm512_storeu_si512(lanes, total[j]);
+      for (auto l : lanes) {
+        sums[j] += fold(l);
+      }
+    }
+
+    powerSumsScalar<K>(it + vectors, n - vectors, sums);
+  }
+
+  template <size_t K>
+  void powerSums(const uint64_t* it, size_t n, uint64_t* sums) {
+    if (reduction::activeIsa() == reduction::Isa::Avx512) {
+      powerSumsAvx512<K>(it, n, sums);
+    }
+    else {
+      powerSumsScalar<K>(it, n, sums);
+    }
+  }
+
+  using PowerSumsFn = void (*)(const uint64_t*, size_t, uint64_t*);
+
+  // kernels per K, group sizes are known at compile time
+  template <size_t... K>
+  constexpr std::array<PowerSumsFn, sizeof...(K)> powerSumsTable(std::index_sequence<K...>) {
+    return { &powerSums<K + 1>... };
+  }
+
+  // one more than MAX_K for the check sum
+  constexpr auto POWER_SUMS = powerSumsTable(std::make_index_sequence<MAX_K + 1>());
+
+  /**
+  * Sum of x^j over 0..n-1 for j = 1..k, from
+  * n^(j+1) = sum C(j+1, i) * S_i, i = 0..j
+  */
+  vector<uint64_t> rangePowerSums(uint64_t n, size_t k) {
+    vector<uint64_t> s(k + 1);
+    s[0] = n % P;
+
+    for (size_t j = 1; j <= k; ++j) {
+      uint64_t rest = 0;
+      uint64_t binom = 1; // C(j+1, i)
+      for (size_t i = 0; i < j; ++i) {
+        rest = add(rest, mul(binom, s[i]));
+        binom = mul(mul(binom, j + 1 - i), inverse(i + 1));
+      }
+      s[j] = mul(sub(pow(n % P, j + 1), rest), inverse(j + 1));
+    }
+
+    return s;
+  }
+}
+
+
+/**
+* k missing values of 0..n+k-1, data holds the other n, in any order.
+* One SIMD pass collects power sums 1..k of data mod 2^31-1. Their
+* difference with power sums of the full range are power sums of the
+* missing values, Newton's identities turn them into the polynomial
+* with missing values as roots, which is factored. O(k) memory.
+* Power sum k+1 checks the roots. Returns sorted values, empty if 
+* data has duplicates or values out of range (with high probability).
+* n + k must be below 2^31 - 1, k up to 32.
+*/
+vector<uint64_t> findMissingK(const uint64_t* data, size_t n, size_t k) {
+  using namespace primeField;
+
+  if (k > missingK::MAX_K || n + k >= P) {
+    throw std::invalid_argument("findMissingK: k up to 32, range below 2^31 - 1");
+  }
+  if (k == 0) {
+    return {};
+  }
+
+  vector<uint64_t> sums(k + 1, 0);
+  missingK::POWER_SUMS[k](data, n, sums.data());
+
+  auto range = missingK::rangePowerSums(n + k, k + 1);
+
+  // power sums of missing values
+  vector<uint64_t> d(k + 2, 0);
+  for (size_t j = 1; j <= k + 1; ++j) {
+    d[j] = sub(range[j], reduce(sums[j - 1]));
+  }
+
+  // elementary symmetric polynomials by Newton's identities
+  vector<uint64_t> e(k + 1, 0);
+  e[0] = 1;
+  for (size_t j = 1; j <= k; ++j) {
+    uint64_t acc = 0;
+    for (size_t i = 1; i <= j; ++i) {
+      auto t = mul(e[j - i], d[i]);
+      acc = i & 1 ? add(acc, t) : sub(acc, t);
+    }
+    e[j] = mul(acc, inverse(j));
+  }
+
+  // prod (x - m) = sum (-1)^j e_j x^(k-j)
+  Poly f(k + 1);
+  for (size_t j = 0; j <= k; ++j) {
+    f[k - j] = j & 1 ? sub(0, e[j]) : e[j];
+  }
+
+  // all roots must be distinct field elements: f divides x^P - x
+  auto xp = powMod(Poly{ 0, 1 }, P, f);
+  xp.resize(std::max<size_t>(xp.size(), 2), 0);
+  xp[1] = sub(xp[1], 1);
+
+  if (gcd(f, xp).size() != k + 1) {
+    return {};
+  }
+
+  vector<uint64_t> res;
+  roots(f, res);
+  std::sort(res.begin(), res.end());
+
+  if (res.size() != k || res.back() >= n + k) {
+    return {};
+  }
+
+  uint64_t check = 0;
+  for (auto r : res) {
+    check = add(check, pow(r, k + 1));
+  }
+
+  return check == d[k + 1] ? res : vector<uint64_t>();
+}
+
+
+/**
+* One value of 0..n-1 duplicated, another one missing.
+* XOR gives only dup ^ missing, so the same pass also sums values and
+* their squares (mod 2^64):
+*   S1 = dup - missing, S2 = dup^2 - missing^2 = S1 * (dup + missing)
+* XOR checks the result.
+*/
+namespace setMismatch {
+  struct Sums {
+    uint64_t x = 0;   // xor
+    uint64_t s1 = 0;  // sum
+    uint64_t s2 = 0;  // sum of squares
+
+    void add(const Sums& o) {
+      x ^= o.x;
+      s1 += o.s1;
+      s2 += o.s2;
+    }
+  };
+
+  Sums sumsScalar(const uint64_t* it, size_t n) {
+    Sums res;
+    for (size_t i = 0; i < n; ++i) {
+      res.x ^= it[i];
+      res.s1 += it[i];
+      res.s2 += it[i] * it[i];
+    }
+    return res;
+  }
+
+  Sums sumsAvx512(const uint64_t* it, size_t n) {
+    auto x0 = _mm512_setzero_si512(), x1 = x0;
+    auto s0 = x0, s1 = x0;
+    auto q0 = x0, q1 = x0;
+    size_t i = 0;
+
+    // two independent sets, mullo_epi64 has long latency
+    for (; i + 16 <= n; i += 16) {
+      auto a = _mm512_loadu_si512(it + i);
+      auto b = _mm512_loadu_si512(it + i + 8);
+
+      x0 = _mm512_xor_si512(x0, a);
+      x1 = _mm512_xor_si512(x1, b);
+      s0 = _mm512_add_epi64(s0, a);
+      s1 = _mm512_add_epi64(s1, b);
+      q0 = _mm512_add_epi64(q0, _mm512_mullo_epi64(a, a));
+      q1 = _mm512_add_epi64(q1, _mm512_mullo_epi64(b, b));
+    }
+
+    uint64_t lx[8], ls[8], lq[8];
+    _mm512_storeu_si512(lx, _mm512_xor_si512(x0, x1));
+    _mm512_storeu_si512(ls, _mm512_add_epi64(s0, s1));
+    _mm512_storeu_si512(lq, _mm512_add_epi64(q0, q1));
+
+    auto res = sumsScalar(it + i, n - i);
+    for (size_t l = 0; l < 8; ++l) {
+      res.add({ lx[l], ls[l], lq[l] });
+    }
+    return res;
+  }
+
+  Sums sums(const uint64_t* it, size_t n) {
+    return reduction::activeIsa() == reduction::Isa::Avx512 ? 
+      sumsAvx512(it, n) : sumsScalar(it, n);
+  }
+
+  // 0..n-1, n(n-1)/2 and (n-1)n(2n-1)/6 mod 2^64 without overflow
+  Sums rangeSums(uint64_t n) {
+    if (n == 0) {
+      return {};
+    }
+
+    uint64_t f[3] = { n - 1, n, 2 * n - 1 };
+
+    uint64_t half[2] = { f[0], f[1] };
+    half[f[0] % 2 ? 1 : 0] /= 2;
+
+    f[f[0] % 3 == 0 ? 0 : f[1] % 3 == 0 ? 1 : 2] /= 3;
+    f[f[0] % 2 ? 1 : 0] /= 2;
+
+    return { getInintialConstant(n), half[0] * half[1], f[0] * f[1] * f[2] };
+  }
+
+  // inverse of odd a mod 2^64, Newton iteration doubles correct bits
+  uint64_t inverse(uint64_t a) {
+    uint64_t x = a;   // correct to 3 bits
+    for (int i = 0; i < 5; ++i) {
+      x *= 2 - a * x;
+    }
+    return x;
+  }
+
+  /**
+  * d = dup - missing and d * (dup + missing) are known mod 2^64,
+  * dup + missing is exact while below 2^(64 - trailing zeros of d)
+  */
+  std::optional<std::pair<uint64_t, uint64_t>> solve(const Sums& data, uint64_t n) {
+    auto range = rangeSums(n);
+    uint64_t d = data.s1 - range.s1;
+    uint64_t q = data.s2 - range.s2;
+
+    if (d == 0) {
+      return std::nullopt;
+    }
+
+    auto tz = _tzcnt_u64(d);
+    uint64_t sum = (q >> tz) * inverse(d >> tz);
+    if (tz) {
+      sum &= ~0ull >> tz;
+    }
+
+    uint64_t dup = (sum + d) / 2;
+    uint64_t missing = (sum - d) / 2;
+
+    if (dup >= n || missing >= n || (dup ^ missing) != (data.x ^ range.x)) {
+      return std::nullopt;
+    }
+
+    return std::make_pair(dup, missing);
+  }
+}
+
+
+struct SetMismatch {
+  uint64_t duplicate;
+  uint64_t missing;
+};
+
+/**
+* v holds 0..v.size()-1 with one value duplicated and one missing.
+* Empty if data doesn't look like that.
+*/
+std::optional<SetMismatch> findMismatch(const vector<uint64_t>& v) {
+  auto r = setMismatch::solve(setMismatch::sums(v.data(), v.size()), v.size());
+  if (!r) {
+    return std::nullopt;
+  }
+  return SetMismatch{ r->first, r->second };
+}
+
+std::optional<SetMismatch> findMismatchParallel(const vector<uint64_t>& v, unsigned threads = 0) {
+  threads = parallel::threadsFor(v.size(), reduction::PARALLEL_PART, threads);
+  if (threads < 2) {
+    return findMismatch(v);
+  }
+
+  vector<setMismatch::Sums> partial(threads);
+  parallel::split(v.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+    partial[t] = setMismatch::sums(v.data() + begin, end - begin);
+  }, 8);
+
+  for (unsigned t = 1; t < threads; ++t) {
+    partial[0].add(partial[t]);
+  }
+
+  auto r = setMismatch::solve(partial[0], v.size());
+  if (!r) {
+    return std::nullopt;
+  }
+  return SetMismatch{ r->first, r->second };
+}
+
+
+/**
+* Reductions over ID files (raw little endian uint64) of any size.
+* File is mapped, threads take CHUNK sized pieces in order from a 
+* shared counter, so the whole scan moves front to back and read-ahead
+* keeps up. Scanned pieces are released, resident memory stays at
+* about threads * CHUNK.
+*/
+namespace fileScan {
+  constexpr size_t CHUNK = 64 << 20;
+
+  /**
+  * kernel(values, count) for every chunk, results in file order
+  */
+  template <typename Kernel>
+  auto scan(const MappedFile& file, unsigned threads, Kernel kernel) {
+    if (file.size() % sizeof(uint64_t)) {
+      throw std::runtime_error("ID file size is not a multiple of 8");
+    }
+
+    using Partial = decltype(kernel((const uint64_t*)nullptr, (size_t)0));
+
+    auto chunks = (file.size() + CHUNK - 1) / CHUNK;
+    vector<Partial> res(chunks);
+
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::min<size_t>(threads, std::max<size_t>(chunks, 1));
+
+    file.advise_sequential();
+
+    std::atomic<size_t> next(0);
+    auto values = reinterpret_cast<const uint64_t*>(file.data());
+
+    auto worker = [&]() {
+      for (size_t c; (c = next.fetch_add(1)) < chunks;) {
+        auto offset = c * CHUNK;
+        auto bytes = std::min(CHUNK, file.size() - offset);
+
+        res[c] = kernel(values + offset / sizeof(uint64_t), bytes / sizeof(uint64_t));
+        file.release(offset, bytes);
+      }
+    };
+
+    vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+      workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& w : workers) {
+      w.join();
+    }
+
+    return res;
+  }
+}
+
+
+/**
+* findMissed over a file of 0..n except one value, n = size / 8
+*/
+uint64_t findMissedInFile(const std::string& path, unsigned threads = 0) {
+  MappedFile file(path);
+
+  auto partial = fileScan::scan(file, threads, [](const uint64_t* it, size_t n) {
+    return reduction::reduce<reduction::Xor>(it, n);
+  });
+
+  uint64_t n = file.size() / sizeof(uint64_t);
+  return getInintialConstant(n + 1) ^ 
+    reduction::reduceScalar<reduction::Xor>(partial.data(), partial.size());
+}
+
+/**
+* findMismatch over a file of 0..size/8-1, one value duplicated
+*/
+std::optional<SetMismatch> findMismatchInFile(const std::string& path, unsigned threads = 0) {
+  MappedFile file(path);
+
+  auto partial = fileScan::scan(file, threads, [](const uint64_t* it, size_t n) {
+    return setMismatch::sums(it, n);
+  });
+
+  setMismatch::Sums total;
+  for (const auto& p : partial) {
+    total.add(p);
+  }
+
+  auto r = setMismatch::solve(total, file.size() / sizeof(uint64_t));
+  if (!r) {
+    return std::nullopt;
+  }
+  return SetMismatch{ r->first, r->second };
+}
+
+
+/**
+* Invertible Bloom lookup table: set reconciliation where findMissed
+* is the case of one difference. Every key goes to one cell in each of
+* 4 subtables, a cell keeps XOR of keys, XOR of key check hashes and
+* count. Table of one replica minus table of the other holds only the
+* difference, which is listed by peeling cells with one key left.
+* Size depends on the difference, not on the sets: cellsFor(d).
+* Tables can be combined only with the same size and seed.
+*/
+class Iblt {
+  static constexpr size_t HASHES = 4;
+
+  vector<uint64_t> _keys;
+  vector<uint64_t> _checks;
+  vector<int64_t> _counts;
+  uint64_t _sub;              // cells per subtable
+  uint64_t _seed;
+
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  static __m512i mix(__m512i z) {
+    z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_srli_epi64(z, 30)), 
+      _mm512_set1_epi64(0xbf58476d1ce4e5b9ull));
+    z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_srli_epi64(z, 27)), 
+      _mm512_set1_epi64(0x94d049bb133111ebull));
+    return _mm512_xor_si512(z, _mm512_srli_epi64(z, 31));
+  }
+
+  static constexpr uint64_t CHECK_SALT = 0x9e3779b97f4a7c15ull;
+
+  uint64_t check(uint64_t key) const {
+    return mix(mix(key ^ _seed) ^ CHECK_SALT);
+  }
+
+  // 32 bit hash to subtable j, by multiply-shift
+  void cellsOf(uint64_t key, uint64_t (&cells)[HASHES], uint64_t& chk) const {
+    auto h1 = mix(key ^ _seed);
+    auto h2 = mix(h1 ^ CHECK_SALT);
+    cells[0] = ((h1 & 0xFFFFFFFF) * _sub) >> 32;
+    cells[1] = _sub + (((h1 >> 32) * _sub) >> 32);
+    cells[2] = 2 * _sub + (((h2 & 0xFFFFFFFF) * _sub) >> 32);
+    cells[3] = 3 * _sub + (((h2 >> 32) * _sub) >> 32);
+    chk = h2;
+  }
+
+  void update(uint64_t key, int64_t sign) {
+    uint64_t cells[HASHES];
+    uint64_t chk;
+    cellsOf(key, cells, chk);
+
+    for (auto c : cells) {
+      _keys[c] ^= key;
+      _checks[c] ^= chk;
+      _counts[c] += sign;
+    }
+  }
+
+  bool pure(size_t c) const {
+    return (_counts[c] == 1 || _counts[c] == -1) && check(_keys[c]) == _checks[c];
+  }
+
+  void requireCompatible(const Iblt& o) const {
+    if (_sub != o._sub || _seed != o._seed) {
+      throw std::invalid_argument("Iblt: tables differ in size or seed");
+    }
+  }
+
+public:
+  /**
+  * Cells for about d differences. Peeling threshold of 4 hashes is
+  * 1.3 d, with 3 hashes two keys sharing all their cells is already
+  * likely at a few hundred differences.
+  */
+  static size_t cellsFor(size_t d) {
+    return d + d / 2 + 30;
+  }
+
+  explicit Iblt(size_t cells, uint64_t seed = 0) :
+    _sub(std::max<size_t>(1, (cells + HASHES - 1) / HASHES)),
+    _seed(seed)
+  {
+    _keys.assign(_sub * HASHES, 0);
+    _checks.assign(_sub * HASHES, 0);
+    _counts.assign(_sub * HASHES, 0);
+  }
+
+  void insert(uint64_t key) {
+    update(key, 1);
+  }
+
+  void erase(uint64_t key) {
+    update(key, -1);
+  }
+
+  void insert(const uint64_t* keys, size_t n) {
+    size_t i = 0;
+
+    if (reduction::activeIsa() == reduction::Isa::Avx512) {
+      const auto seed = _mm512_set1_epi64(_seed);
+      const auto salt = _mm512_set1_epi64(CHECK_SALT);
+      const auto sub = _mm512_set1_epi64(_sub);
+      const auto sub2 = _mm512_set1_epi64(2 * _sub);
+      const auto sub3 = _mm512_set1_epi64(3 * _sub);
+
+      alignas(64) uint64_t c0[8], c1[8], c2[8], c3[8], chk[8];
+
+      for (; i + 8 <= n; i += 8) {
+        auto k = _mm512_loadu_si512(keys + i);
+        auto h1 = mix(_mm512_xor_si512(k, seed));
+        auto h2 = mix(_mm512_xor_si512(h1, salt));
+
+        // mul_epu32 takes low 32 bits, as (h & 0xFFFFFFFF) * sub
+        _mm512_store_si512(c0, _mm512_srli_epi64(_mm512_mul_epu32(h1, sub), 32));
+        _mm512_store_si512(c1, _mm512_add_epi64(sub, 
+          _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(h1, 32), sub), 32)));
+        _mm512_store_si512(c2, _mm512_add_epi64(sub2, 
+          _mm512_srli_epi64(_mm512_mul_epu32(h2, sub), 32)));
+        _mm512_store_si512(c3, _mm512_add_epi64(sub3, 
+          _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(h2, 32), sub), 32)));
+        _mm512_store_si512(chk, h2);
+
+        // cells may repeat inside the vector, update one by one
+        for (size_t l = 0; l < 8; ++l) {
+          auto key = keys[i + l];
+          _keys[c0[l]] ^= key;
+          _keys[c1[l]] ^= key;
+          _keys[c2[l]] ^= key;
+          _keys[c3[l]] ^= key;
+          _checks[c0[l]] ^= chk[l];
+          _checks[c1[l]] ^= chk[l];
+          _checks[c2[l]] ^= chk[l];
+          _checks[c3[l]] ^= chk[l];
+          ++_counts[c0[l]];
+          ++_counts[c1[l]];
+          ++_counts[c2[l]];
+          ++_counts[c3[l]];
+        }
+      }
+    }
+
+    for (; i < n; ++i) {
+      update(keys[i], 1);
+    }
+  }
+
+  /**
+  * Table of a large set, parts are inserted into thread local 
+  * tables and added together
+  */
+  void insertParallel(const uint64_t* keys, size_t n, unsigned threads = 0) {
+    threads = parallel::threadsFor(n, reduction::PARALLEL_PART, threads);
+    if (threads < 2) {
+      insert(keys, n);
+      return;
+    }
+
+    vector<Iblt> partial(threads - 1, Iblt(_sub * HASHES, _seed));
+
+    parallel::split(n, threads, [&](unsigned t, size_t begin, size_t end) {
+      (t == 0 ? *this : partial[t - 1]).insert(keys + begin, end - begin);
+    }, 8);
+
+    for (const auto& p : partial) {
+      add(p);
+    }
+  }
+
+  // multiset union
+  void add(const Iblt& o) {
+    requireCompatible(o);
+    for (size_t c = 0; c < _keys.size(); ++c) {
+      _keys[c] ^= o._keys[c];
+      _checks[c] ^= o._checks[c];
+      _counts[c] += o._counts[c];
+    }
+  }
+
+  /**
+  * this - o: keys of both sets cancel out, SIMD over cells
+  */
+  void subtract(const Iblt& o) {
+    requireCompatible(o);
+
+    size_t c = 0;
+    if (reduction::activeIsa() == reduction::Isa::Avx512) {
+      for (; c + 8 <= _keys.size(); c += 8) {
+        _mm512_storeu_si512(&_keys[c], _mm512_xor_si512(
+          _mm512_loadu_si512(&_keys[c]), _mm512_loadu_si512(&o._keys[c])));
+        _mm512_storeu_si512(&_checks[c], _mm512_xor_si512(
+          _mm512_loadu_si512(&_checks[c]), _mm512_loadu_si512(&o._checks[c])));
+        _mm512_storeu_si512(&_counts[c], _mm512_sub_epi64(
+          _mm512_loadu_si512(&_counts[c]), _mm512_loadu_si512(&o._counts[c])));
+      }
+    }
+
+    for (; c < _keys.size(); ++c) {
+      _keys[c] ^= o._keys[c];
+      _checks[c] ^= o._checks[c];
+      _counts[c] -= o._counts[c];
+    }
+  }
+
+  /**
+  * List keys of a subtracted table: count +1 - only in this set,
+  * -1 - only in the other one. False if peeling got stuck (table
+  * too small for the difference), lists are partial then.
+  */
+  bool decode(vector<uint64_t>& onlyHere, vector<uint64_t>& onlyOther) const {
+    Iblt t(*this);
+    onlyHere.clear();
+    onlyOther.clear();
+
+    vector<size_t> queue;
+    for (size_t c = 0; c < t._keys.size(); ++c) {
+      if (t.pure(c)) {
+        queue.push_back(c);
+      }
+    }
+
+    while (!queue.empty()) {
+      auto c = queue.back();
+      queue.pop_back();
+
+      // may be emptied by a key peeled from another cell
+      if (!t.pure(c)) {
+        continue;
+      }
+
+      auto key = t._keys[c];
+      auto sign = t._counts[c];
+      (sign > 0 ? onlyHere : onlyOther).push_back(key);
+
+      uint64_t cells[HASHES];
+      uint64_t chk;
+      t.cellsOf(key, cells, chk);
+      t.update(key, -sign);
+
+      for (auto n : cells) {
+        if (t.pure(n)) {
+          queue.push_back(n);
+        }
+      }
+    }
+
+    for (size_t c = 0; c < t._keys.size(); ++c) {
+      if (t._counts[c] != 0 || t._keys[c] != 0 || t._checks[c] != 0) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  size_t cells() const {
+    return _keys.size();
+  }
+
+  // bytes to send to the other replica
+  size_t size_bytes() const {
+    return _keys.size() * (sizeof(uint64_t) * 2 + sizeof(int64_t));
+  }
+};
+
+
+/**
+* Gaps in an unbounded stream of out of order sequence numbers.
+* The XOR trick of findMissed tells only that something is missing,
+* so every sequence number in the window gets a bit in a ring bitmap,
+* and a closed all-ones word is the common "nothing missed" case.
+* Window slides forward with the highest number seen, numbers that
+* fall out of it are gaps. Numbers arriving behind the window are
+* counted as late and dropped, so window must cover reordering.
+* Memory is window / 8 bytes.
+*/
+class GapDetector {
+public:
+  struct Gap {
+    uint64_t first;
+    uint64_t count;
+  };
+
+private:
+  vector<uint64_t> _bits;
+  uint64_t _mask;             // ring words - 1
+  uint64_t _window;           // in sequence numbers, 64 * words
+  uint64_t _base;             // first open number, multiple of 64
+  uint64_t _end;              // highest seen + 1
+  uint64_t _late;
+  vector<Gap> _gaps;
+  vector<uint64_t> _sorted;   // batches wider than the window
+
+  void addGap(uint64_t first, uint64_t count) {
+    if (!_gaps.empty() && _gaps.back().first + _gaps.back().count == first) {
+      _gaps.back().count += count;
+    }
+    else {
+      _gaps.push_back({ first, count });
+    }
+  }
+
+  // close words below base, to is a multiple of 64
+  void advance(uint64_t to) {
+    auto closeTo = std::min(to, _base + _window);
+
+    for (; _base < closeTo; _base += 64) {
+      auto& w = _bits[(_base >> 6) & _mask];
+
+      for (auto zeros = ~w; zeros; zeros &= zeros - 1) {
+        addGap(_base + _tzcnt_u64(zeros), 1);
+      }
+
+      w = 0;
+    }
+
+    // jump over the whole window, nothing of it was seen
+    if (to > _base) {
+      addGap(_base, to - _base);
+      _base = to;
+    }
+  }
+
+public:
+  /**
+  * window - reordering to tolerate: anything not below highest seen
+  * minus window is accepted. Ring is the next power of 2 of
+  * window + 64 bits. first - first expected number
+  */
+  explicit GapDetector(uint64_t window = 1 << 20, uint64_t first = 0) :
+    _base(first & ~63ull),
+    _end(first),
+    _late(0)
+  {
+    uint64_t words = 1;
+    while (words * 64 < window + 64) {
+      words <<= 1;
+    }
+
+    _bits.assign(words, 0);
+    _mask = words - 1;
+    _window = words * 64;
+
+    // numbers before first are not expected
+    _bits[(_base >> 6) & _mask] = (1ull << (first & 63)) - 1;
+  }
+
+  void insert(const uint64_t* seqs, size_t n) {
+    if (n == 0) {
+      return;
+    }
+
+    uint64_t low = seqs[0];
+    uint64_t high = seqs[0];
+    for (size_t i = 1; i < n; ++i) {
+      low = std::min(low, seqs[i]);
+      high = std::max(high, seqs[i]);
+    }
+
+    // rare: a jump inside the batch, slide as values go up
+    if (high - low > _window - 64) {
+      _sorted.assign(seqs, seqs + n);
+      std::sort(_sorted.begin(), _sorted.end());
+
+      for (auto v : _sorted) {
+        if (v >= _base + _window) {
+          advance(((v >> 6) + 1) * 64 - _window);
+        }
+
+        if (v < _base) {
+          ++_late;
+        }
+        else {
+          _bits[(v >> 6) & _mask] |= 1ull << (v & 63);
+        }
+      }
+
+      _end = std::max(_end, high + 1);
+      return;
+    }
+
+    // slide first, so that the whole batch goes through one SIMD pass
+    if (high >= _base + _window) {
+      advance(((high >> 6) + 1) * 64 - _window);
+    }
+    _end = std::max(_end, high + 1);
+
+    size_t i = 0;
+
+    if (reduction::activeIsa() == reduction::Isa::Avx512) {
+      const auto base = _mm512_set1_epi64(_base);
+      const auto mask = _mm512_set1_epi64(_mask);
+      const auto one = _mm512_set1_epi64(1);
+      const auto lowBits = _mm512_set1_epi64(63);
+
+      alignas(64) uint64_t idx[8];
+      alignas(64) uint64_t bit[8];
+
+      for (; i + 8 <= n; i += 8) {
+        auto s = _mm512_loadu_si512(seqs + i);
+        __mmask8 late = _mm512_cmplt_epu64_mask(s, base);
+
+        _mm512_store_si512(idx, _mm512_and_si512(_mm512_srli_epi64(s, 6), mask));
+        _mm512_store_si512(bit, _mm512_sllv_epi64(one, _mm512_and_si512(s, lowBits)));
+
+        // lanes may share a word, so OR them one by one
+        if (late == 0) {
+          for (size_t l = 0; l < 8; ++l) {
+            _bits[idx[l]] |= bit[l];
+          }
+          continue;
+        }
+
+        for (unsigned m = (uint8_t)~late; m; m &= m - 1) {
+          auto l = _tzcnt_u32(m);
+          _bits[idx[l]] |= bit[l];
+        }
 
+        _late += _mm_popcnt_u32(late);
+      }
+    }
 
-    for (uint64_t i = 0; i < t; ++i) {
-      res[i] = i;
+    for (; i < n; ++i) {
+      if (seqs[i] < _base) {
+        ++_late;
+      }
+      else {
+        _bits[(seqs[i] >> 6) & _mask] |= 1ull << (seqs[i] & 63);
+      }
     }
+  }
+
+  void insert(const vector<uint64_t>& seqs) {
+    insert(seqs.data(), seqs.size());
+  }
 
-    for (uint64_t i = t + 1; i < n; ++i) {
-      res[i - 1] = i;
+  /**
+  * End of stream: everything up to the highest seen number is closed
+  */
+  void flush() {
+    // numbers after the highest one are not expected yet
+    if (_end & 63) {
+      _bits[(_end >> 6) & _mask] |= ~0ull << (_end & 63);
     }
 
-    std::random_device rng;
-    std::mt19937 urng(rng());
+    advance((_end + 63) & ~63ull);
+  }
 
-    shuffle(begin(res), end(res), urng);
+  /**
+  * Gaps confirmed since last call, ascending
+  */
+  vector<Gap> take_gaps() {
+    vector<Gap> res;
+    res.swap(_gaps);
     return res;
   }
-}
 
+  uint64_t late() const {
+    return _late;
+  }
+
+  // numbers below are closed
+  uint64_t base() const {
+    return _base;
+  }
 
+  uint64_t window() const {
+    return _window;
+  }
+};
 
-uint64_t findMissed(const vector<uint64_t>& v) {
-  uint64_t res = 0ull;
 
-  // Todo: do in compile time, if we know size
-  for (uint64_t i = 0; i < v.size() + 1; ++i) {
-    res ^= i;
+/**
+* Set of uint64 IDs, roaring style: values are grouped by the high 48
+* bits, low 16 bits of a group are kept in the smallest of
+*   array   - sorted values, up to 4096 of them
+*   bitmap  - 1024 words
+*   run     - (start, length - 1) pairs, a near-complete group is 
+*             a handful of runs
+* Gaps of a run container are between its runs, so missing ranges
+* of a near-complete ID space are listed in O(#gaps + #groups).
+*/
+class IdBitmap {
+public:
+  struct Range {
+    uint64_t first;
+    uint64_t count;
+  };
+
+private:
+  static constexpr size_t WORDS = 1024;
+  static constexpr size_t ARRAY_MAX = 4096;
+
+  enum class Kind : uint8_t {
+    Array,
+    Bitmap,
+    Run
+  };
+
+  struct Container {
+    Kind kind;
+    uint32_t card;
+    vector<uint16_t> values;  // array values, or run start, length - 1
+    vector<uint64_t> words;
+  };
+
+  vector<uint64_t> _keys;     // high 48 bits, ascending
+  vector<Container> _containers;
+  vector<uint64_t> _prefix;   // values in containers before i
+
+  // the smallest kind for the bits in w
+  static Container fromWords(const uint64_t* w) {
+    uint32_t card = 0;
+    uint32_t runs = 0;
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < WORDS; ++i) {
+      card += (uint32_t)_mm_popcnt_u64(w[i]);
+      // run starts: set bits with clear bit below
+      runs += (uint32_t)_mm_popcnt_u64(w[i] & ~((w[i] << 1) | carry));
+      carry = w[i] >> 63;
+    }
+
+    Container c{ Kind::Bitmap, card, {}, {} };
+
+    if (runs * 2 <= std::min<uint32_t>(card, WORDS * 4 - 1)) {
+      c.kind = Kind::Run;
+      c.values.reserve(runs * 2);
+
+      for (uint32_t pos = 0; pos < WORDS * 64;) {
+        auto start = nextBit(w, pos, false);
+        if (start >= WORDS * 64) {
+          break;
+        }
+        auto end = nextBit(w, start, true);
+        c.values.push_back((uint16_t)start);
+        c.values.push_back((uint16_t)(end - start - 1));
+        pos = end;
+      }
+    }
+    else if (card <= ARRAY_MAX) {
+      c.kind = Kind::Array;
+      c.values.reserve(card);
+
+      for (size_t i = 0; i < WORDS; ++i) {
+        for (auto b = w[i]; b; b &= b - 1) {
+          c.values.push_back((uint16_t)(i * 64 + _tzcnt_u64(b)));
+        }
+      }
+    }
+    else {
+      c.words.assign(w, w + WORDS);
+    }
+
+    return c;
   }
 
-  for (const auto& i : v) {
-    res ^= i;
+  // first position from pos with bit set (or clear if clear), 65536 if none
+  static uint32_t nextBit(const uint64_t* w, uint32_t pos, bool clear) {
+    for (uint32_t i = pos >> 6; i < WORDS; ++i) {
+      auto word = clear ? ~w[i] : w[i];
+      if (i == pos >> 6) {
+        word &= ~0ull << (pos & 63);
+      }
+      if (word) {
+        return i * 64 + (uint32_t)_tzcnt_u64(word);
+      }
+    }
+    return WORDS * 64;
   }
 
-  return res;
-}
+  static void toWords(const Container& c, uint64_t* w) {
+    if (c.kind == Kind::Bitmap) {
+      std::copy(c.words.begin(), c.words.end(), w);
+      return;
+    }
+
+    std::fill(w, w + WORDS, 0);
 
+    if (c.kind == Kind::Array) {
+      for (auto v : c.values) {
+        w[v >> 6] |= 1ull << (v & 63);
+      }
+      return;
+    }
 
-uint64_t getInintialConstant(uint64_t n) {
-  uint64_t res = 0ull;
-  auto lz = __lzcnt64(n);
+    for (size_t r = 0; r < c.values.size(); r += 2) {
+      uint32_t first = c.values[r];
+      uint32_t end = first + c.values[r + 1] + 1;
 
-  for (uint64_t i = 1ull << (63 - lz); i < n; ++i) {
-    res ^= i;
+      for (; first < end && (first & 63); ++first) {
+        w[first >> 6] |= 1ull << (first & 63);
+      }
+      for (; first + 64 <= end; first += 64) {
+        w[first >> 6] = ~0ull;
+      }
+      for (; first < end; ++first) {
+        w[first >> 6] |= 1ull << (first & 63);
+      }
+    }
   }
 
-  return res;
-}
+  // values below low
+  static uint32_t rankIn(const Container& c, uint32_t low) {
+    if (c.kind == Kind::Array) {
+      return (uint32_t)(std::lower_bound(c.values.begin(), c.values.end(), low) - c.values.begin());
+    }
 
-uint64_t findMissedOptimized(const vector<uint64_t>& v) {
-  uint64_t res = getInintialConstant(v.size() + 1);
+    if (c.kind == Kind::Bitmap) {
+      uint32_t res = 0;
+      for (size_t i = 0; i < (low >> 6); ++i) {
+        res += (uint32_t)_mm_popcnt_u64(c.words[i]);
+      }
+      if (low & 63) {
+        res += (uint32_t)_mm_popcnt_u64(c.words[low >> 6] & ((1ull << (low & 63)) - 1));
+      }
+      return res;
+    }
 
+    uint32_t res = 0;
+    for (size_t r = 0; r < c.values.size() && c.values[r] < low; r += 2) {
+      res += std::min<uint32_t>(c.values[r + 1] + 1, low - c.values[r]);
+    }
+    return res;
+  }
 
-  for (const auto& i : v) {
-    res ^= i;
+  static bool containsIn(const Container& c, uint32_t low) {
+    if (c.kind == Kind::Array) {
+      return std::binary_search(c.values.begin(), c.values.end(), low);
+    }
+
+    if (c.kind == Kind::Bitmap) {
+      return (c.words[low >> 6] >> (low & 63)) & 1;
+    }
+
+    // last run starting at or before low
+    size_t lo = 0;
+    size_t hi = c.values.size() / 2;
+    while (lo < hi) {
+      auto mid = (lo + hi) / 2;
+      if (c.values[mid * 2] <= low) {
+        lo = mid + 1;
+      }
+      else {
+        hi = mid;
+      }
+    }
+
+    return lo > 0 && low - c.values[(lo - 1) * 2] <= c.values[(lo - 1) * 2 + 1];
   }
 
-  return res;
-}
+  // gap(first, count) inside [0, 65536)
+  template <typename F>
+  static void gapsIn(const Container& c, F gap) {
+    uint32_t pos = 0;
 
+    if (c.kind == Kind::Run) {
+      for (size_t r = 0; r < c.values.size(); r += 2) {
+        if (c.values[r] > pos) {
+          gap(pos, c.values[r] - pos);
+        }
+        pos = c.values[r] + c.values[r + 1] + 1;
+      }
+    }
+    else if (c.kind == Kind::Array) {
+      for (auto v : c.values) {
+        if (v > pos) {
+          gap(pos, v - pos);
+        }
+        pos = v + 1u;
+      }
+    }
+    else {
+      while (pos < WORDS * 64) {
+        auto start = nextBit(c.words.data(), pos, true);
+        if (start >= WORDS * 64) {
+          return;
+        }
+        pos = nextBit(c.words.data(), start, false);
+        gap(start, pos - start);
+      }
+      return;
+    }
 
-uint64_t findMissedOptimized2(const vector<uint64_t>& v) {
-  auto size = v.size();
+    if (pos < WORDS * 64) {
+      gap(pos, WORDS * 64 - pos);
+    }
+  }
 
-  if (size < 100) {
-    return findMissed(v);
+  void add(uint64_t key, const uint64_t* w) {
+    auto c = fromWords(w);
+    if (c.card) {
+      _keys.push_back(key);
+      _containers.push_back(std::move(c));
+    }
+  }
+
+  void buildPrefix() {
+    _prefix.resize(_containers.size() + 1);
+    _prefix[0] = 0;
+    for (size_t i = 0; i < _containers.size(); ++i) {
+      _prefix[i + 1] = _prefix[i] + _containers[i].card;
+    }
+  }
+
+  // sparse input: sorted copy, groups of up to ARRAY_MAX go to arrays
+  void buildSorted(const uint64_t* ids, size_t n) {
+    vector<uint64_t> sorted(ids, ids + n);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    vector<uint64_t> w(WORDS);
+
+    for (size_t i = 0; i < sorted.size();) {
+      auto key = sorted[i] >> 16;
+      auto j = i;
+      while (j < sorted.size() && sorted[j] >> 16 == key) {
+        ++j;
+      }
+
+      if (j - i <= ARRAY_MAX / 4) {
+        Container c{ Kind::Array, (uint32_t)(j - i), {}, {} };
+        for (auto k = i; k < j; ++k) {
+          c.values.push_back((uint16_t)sorted[k]);
+        }
+        _keys.push_back(key);
+        _containers.push_back(std::move(c));
+      }
+      else {
+        std::fill(w.begin(), w.end(), 0);
+        for (auto k = i; k < j; ++k) {
+          w[(sorted[k] >> 6) & (WORDS - 1)] |= 1ull << (sorted[k] & 63);
+        }
+        add(key, w.data());
+      }
+
+      i = j;
+    }
   }
 
-  uint64_t res = getInintialConstant(size + 1);
+  struct Or {
+    static uint64_t apply(uint64_t x, uint64_t y) {
+      return x | y;
+    }
+
+    static __m512i apply(__m512i x, __m512i y) {
+      return _mm512_or_si512(x, y);
+    }
+  };
+
+  struct And {
+    static uint64_t apply(uint64_t x, uint64_t y) {
+      return x & y;
+    }
+
+    static __m512i apply(__m512i x, __m512i y) {
+      return _mm512_and_si512(x, y);
+    }
+  };
+
+  template <typename Op>
+  static IdBitmap combine(const IdBitmap& a, const IdBitmap& b, bool unite) {
+    const bool avx512 = reduction::activeIsa() == reduction::Isa::Avx512;
+    IdBitmap res;
+    vector<uint64_t> wa(WORDS), wb(WORDS);
+
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < a._keys.size() || j < b._keys.size()) {
+      bool inA = i < a._keys.size() && (j == b._keys.size() || a._keys[i] <= b._keys[j]);
+      bool inB = j < b._keys.size() && (i == a._keys.size() || b._keys[j] <= a._keys[i]);
+
+      if (inA && inB) {
+        toWords(a._containers[i], wa.data());
+        toWords(b._containers[j], wb.data());
 
-  const uint64_t* it = &(*begin(v));
-  const uint64_t* e = &(*end(v));
+        if (avx512) {
+          for (size_t k = 0; k < WORDS; k += 8) {
+            _mm512_storeu_si512(&wa[k], Op::apply(
+              _mm512_loadu_si512(&wa[k]), _mm512_loadu_si512(&wb[k])));
+          }
+        }
+        else {
+          for (size_t k = 0; k < WORDS; ++k) {
+            wa[k] = Op::apply(wa[k], wb[k]);
+          }
+        }
 
+        res.add(a._keys[i], wa.data());
+      }
+      else if (unite) {
+        res._keys.push_back(inA ? a._keys[i] : b._keys[j]);
+        res._containers.push_back(inA ? a._containers[i] : b._containers[j]);
+      }
 
-  auto cummul = _mm512_load_si512(it);
-  it += 8;
+      i += inA;
+      j += inB;
+    }
 
-  while (it + 8 < e) {
-    auto tmp = _mm512_load_si512(it);
-    cummul = _mm512_xor_si512(cummul, tmp);
-    it += 8;
+    res.buildPrefix();
+    return res;
   }
 
-  while (it != e) {
-    res ^= *it++;
+public:
+  IdBitmap() {
+    buildPrefix();
   }
 
-  res ^= cummul.m512i_u64[0];
-  res ^= cummul.m512i_u64[1];
-  res ^= cummul.m512i_u64[2];
-  res ^= cummul.m512i_u64[3];
-  res ^= cummul.m512i_u64[4];
-  res ^= cummul.m512i_u64[5];
-  res ^= cummul.m512i_u64[6];
-  res ^= cummul.m512i_u64[7];
+  /**
+  * From unsorted ids, duplicates are fine. Dense input is set
+  * straight into staging bitmaps (indices and masks for 8 ids per 
+  * AVX-512 vector), sparse input is sorted.
+  */
+  IdBitmap(const uint64_t* ids, size_t n) {
+    if (n == 0) {
+      buildPrefix();
+      return;
+    }
 
-  return res;
-}
+    uint64_t low = ids[0];
+    uint64_t high = ids[0];
+    for (size_t i = 1; i < n; ++i) {
+      low = std::min(low, ids[i]);
+      high = std::max(high, ids[i]);
+    }
+
+    auto first = low >> 16;
+    auto span = (high >> 16) - first + 1;
+
+    // staging must not be much larger than input
+    if (span > n / 1024 + 64) {
+      buildSorted(ids, n);
+      buildPrefix();
+      return;
+    }
+
+    vector<uint64_t> staging(span * WORDS, 0);
+    auto base = first << 16;
+    size_t i = 0;
+
+    if (reduction::activeIsa() == reduction::Isa::Avx512) {
+      const auto vbase = _mm512_set1_epi64(base);
+      const auto one = _mm512_set1_epi64(1);
+      const auto lowBits = _mm512_set1_epi64(63);
+
+      alignas(64) uint64_t idx[8];
+      alignas(64) uint64_t bit[8];
+
+      for (; i + 8 <= n; i += 8) {
+        auto v = _mm512_loadu_si512(ids + i);
+        _mm512_store_si512(idx, _mm512_srli_epi64(_mm512_sub_epi64(v, vbase), 6));
+        _mm512_store_si512(bit, _mm512_sllv_epi64(one, _mm512_and_si512(v, lowBits)));
+
+        for (size_t l = 0; l < 8; ++l) {
+          staging[idx[l]] |= bit[l];
+        }
+      }
+    }
+
+    for (; i < n; ++i) {
+      staging[(ids[i] - base) >> 6] |= 1ull << (ids[i] & 63);
+    }
+
+    for (uint64_t k = 0; k < span; ++k) {
+      add(first + k, &staging[k * WORDS]);
+    }
+
+    buildPrefix();
+  }
+
+  explicit IdBitmap(const vector<uint64_t>& ids) :
+    IdBitmap(ids.data(), ids.size())
+  {
+  }
+
+  size_t size() const {
+    return _prefix.back();
+  }
+
+  bool contains(uint64_t id) const {
+    auto it = std::lower_bound(_keys.begin(), _keys.end(), id >> 16);
+    return it != _keys.end() && *it == id >> 16 &&
+      containsIn(_containers[it - _keys.begin()], id & 0xFFFF);
+  }
+
+  // ids below id
+  uint64_t rank(uint64_t id) const {
+    auto it = std::lower_bound(_keys.begin(), _keys.end(), id >> 16);
+    auto i = it - _keys.begin();
+
+    if (it == _keys.end() || *it != id >> 16) {
+      return _prefix[i];
+    }
+    return _prefix[i] + rankIn(_containers[i], id & 0xFFFF);
+  }
+
+  /**
+  * Ranges of [first, end) not in the set, ascending
+  */
+  vector<Range> missing_ranges(uint64_t first, uint64_t end) const {
+    vector<Range> res;
+
+    auto emit = [&](uint64_t from, uint64_t count) {
+      // from + count is 2^64 at the end of the top group
+      auto to = from < end && end - from > count ? from + count : end;
+      from = std::max(first, from);
+      if (from >= to) {
+        return;
+      }
+      if (!res.empty() && res.back().first + res.back().count == from) {
+        res.back().count += to - from;
+      }
+      else {
+        res.push_back({ from, to - from });
+      }
+    };
+
+    uint64_t cursor = first;
+    auto i = std::lower_bound(_keys.begin(), _keys.end(), first >> 16) - _keys.begin();
+
+    for (; i < (ptrdiff_t)_keys.size() && (_keys[i] << 16) < end; ++i) {
+      auto base = _keys[i] << 16;
+      if (base > cursor) {
+        emit(cursor, base - cursor);
+      }
+
+      gapsIn(_containers[i], [&](uint32_t from, uint32_t count) {
+        emit(base + from, count);
+      });
+
+      // top group ends at 2^64, end is below it
+      if (_keys[i] == ~0ull >> 16) {
+        return res;
+      }
+      cursor = base + WORDS * 64;
+    }
+
+    if (cursor < end) {
+      emit(cursor, end - cursor);
+    }
+
+    return res;
+  }
+
+  // from 0 to the highest id
+  vector<Range> missing_ranges() const {
+    if (_keys.empty()) {
+      return {};
+    }
+
+    const auto& c = _containers.back();
+    auto base = _keys.back() << 16;
+    uint64_t high = 0;
+
+    if (c.kind == Kind::Bitmap) {
+      for (size_t i = WORDS; i-- > 0;) {
+        if (c.words[i]) {
+          high = base + i * 64 + 63 - __lzcnt64(c.words[i]);
+          break;
+        }
+      }
+    }
+    else {
+      high = base + c.values[c.values.size() - (c.kind == Kind::Run ? 2 : 1)] +
+        (c.kind == Kind::Run ? c.values.back() : 0);
+    }
+
+    // high is in the set, so [0, high) has the same gaps
+    // and high + 1 can't overflow
+    return missing_ranges(0, high);
+  }
+
+  size_t size_bytes() const {
+    size_t res = _keys.size() * (sizeof(uint64_t) * 2 + sizeof(Container));
+    for (const auto& c : _containers) {
+      res += c.values.size() * sizeof(uint16_t) + c.words.size() * sizeof(uint64_t);
+    }
+    return res;
+  }
+
+  friend IdBitmap operator|(const IdBitmap& a, const IdBitmap& b) {
+    return combine<Or>(a, b, true);
+  }
+
+  friend IdBitmap operator&(const IdBitmap& a, const IdBitmap& b) {
+    return combine<And>(a, b, false);
+  }
+};
 
 
 static constexpr uint64_t N = 50000000;
@@ -115,22 +1990,38 @@ static constexpr uint64_t N = 50000000;
 int main_()
 {
 
-  std::random_device rd; 
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<uint64_t> distrib(1, N);
-
-  uint64_t d = distrib(gen);
+  // fixed seed, every run works on the same data
+  uint64_t d = testData::Stream(testData::DEFAULT_SEED, ~0ull)() % N;
 
   cout << "Missed number: " << d << endl;
 
+  // ID dumps go to the temp directory, not to the working one
+  const std::string idsPath = (std::filesystem::temp_directory_path() / "ids.bin").string();
+
+  auto t1 = chrono::high_resolution_clock::now();
   auto data = testData::missedNumber(N, d);
+  auto t2 = chrono::high_resolution_clock::now();
 
-  cout << "Data generated" << endl;
+  cout << "Data generated in " 
+    << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
+    << " ms" << endl;
 
+  {
+    // one thread and all threads must give the same permutation
+    const uint64_t n = 1 << 20;
+    auto serial = testData::missedNumber(n, 777, 5, 1);
+    auto parallel = testData::missedNumber(n, 777, 5, 3);
 
-  auto t1 = chrono::high_resolution_clock::now();
+    cout << "Reproducible data: " 
+      << (serial == parallel ? "(correct)" : "(Wrong)") << endl;
+  }
+  cout << "ISA: " << reduction::isaName(reduction::activeIsa()) 
+    << ", threads: " << std::thread::hardware_concurrency() << endl;
+
+
+  t1 = chrono::high_resolution_clock::now();
   auto missed = findMissed(data);
-  auto t2 = chrono::high_resolution_clock::now();
+  t2 = chrono::high_resolution_clock::now();
 
   cout << "Execution time: " 
     << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
@@ -160,5 +2051,261 @@ int main_()
 
   cout << "Missed found: " << missed << endl;
 
+
+  // short batch, initial constant folded at compile time
+  {
+    array<uint64_t, 1023> batch;
+    for (uint64_t i = 0; i < batch.size(); ++i) {
+      batch[i] = i < 511 ? i : i + 1;
+    }
+
+    t1 = chrono::high_resolution_clock::now();
+    missed = findMissed(batch);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "Batch execution time: "
+      << std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()
+      << " ns" << endl;
+
+    cout << "Missed found: " << missed << " (511 expected)" << endl;
+  }
+
+
+  // several values absent: drop the last ones of the shuffled data too
+  {
+    const size_t k = 16;
+    vector<uint64_t> expected(data.end() - (k - 1), data.end());
+    expected.push_back(d);
+    std::sort(expected.begin(), expected.end());
+
+    t1 = chrono::high_resolution_clock::now();
+    auto found = findMissingK(data.data(), data.size() - (k - 1), k);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "k = " << k << " execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    cout << "Missed found:";
+    for (auto m : found) {
+      cout << " " << m;
+    }
+    cout << (found == expected ? " (correct)" : " (Wrong)") << endl;
+  }
+
+
+  // stream of sequence numbers with losses and local reordering
+  {
+    vector<uint64_t> lost;
+    auto stream = testData::sequenceStream(N / 5, 0.0001, 4096, lost);
+
+    GapDetector detector(1 << 16);
+    vector<uint64_t> found;
+    const size_t batch = 4096;
+
+    t1 = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < stream.size(); i += batch) {
+      detector.insert(stream.data() + i, std::min(batch, stream.size() - i));
+
+      for (const auto& g : detector.take_gaps()) {
+        for (uint64_t s = g.first; s < g.first + g.count; ++s) {
+          found.push_back(s);
+        }
+      }
+    }
+    detector.flush();
+    t2 = chrono::high_resolution_clock::now();
+
+    for (const auto& g : detector.take_gaps()) {
+      for (uint64_t s = g.first; s < g.first + g.count; ++s) {
+        found.push_back(s);
+      }
+    }
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    cout << "Stream execution time: " << us << " ("
+      << stream.size() / std::max<int64_t>(us, 1) << " M ids/s)" << endl;
+
+    cout << "Gaps found: " << found.size() << ", late: " << detector.late()
+      << (found == lost ? " (correct)" : " (Wrong)") << endl;
+  }
+
+
+  // every ISA must give the same answer, timed for comparison
+  for (auto isa : { reduction::Isa::Scalar, reduction::Isa::Sse2, 
+    reduction::Isa::Avx2, reduction::Isa::Avx512 }) {
+    if (isa > reduction::activeIsa()) {
+      continue;
+    }
+
+    t1 = chrono::high_resolution_clock::now();
+    missed = getInintialConstant(N) ^ 
+      reduction::reduce<reduction::Xor>(data.data() + 1, data.size() - 1, isa) ^ data[0];
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << reduction::isaName(isa) << " execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    cout << "Missed found: " << missed << endl;
+  }
+
+
+  // replicas: B lost the last values of A and got its own new ones
+  {
+    const size_t lostB = 500;
+    const size_t newB = 300;
+
+    vector<uint64_t> fresh(newB);
+    for (size_t i = 0; i < newB; ++i) {
+      fresh[i] = N + i;
+    }
+
+    Iblt a(Iblt::cellsFor(lostB + newB));
+    Iblt b(Iblt::cellsFor(lostB + newB));
+
+    t1 = chrono::high_resolution_clock::now();
+    a.insertParallel(data.data(), data.size());
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "IBLT insert execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << " (" << a.size_bytes() << " bytes table)" << endl;
+
+    b.insertParallel(data.data(), data.size() - lostB);
+    b.insert(fresh.data(), fresh.size());
+
+    vector<uint64_t> onlyA, onlyB;
+
+    t1 = chrono::high_resolution_clock::now();
+    a.subtract(b);
+    bool decoded = a.decode(onlyA, onlyB);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "IBLT subtract and decode execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    vector<uint64_t> expected(data.end() - lostB, data.end());
+    std::sort(expected.begin(), expected.end());
+    std::sort(onlyA.begin(), onlyA.end());
+    std::sort(onlyB.begin(), onlyB.end());
+
+    cout << "Differences found: " << onlyA.size() << " + " << onlyB.size()
+      << (decoded && onlyA == expected && onlyB == fresh ? " (correct)" : " (Wrong)") << endl;
+  }
+
+
+  // present ids as compressed bitmap instead of 400 MB of values
+  {
+    t1 = chrono::high_resolution_clock::now();
+    IdBitmap present(data);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "Bitmap build execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << " (" << present.size_bytes() << " bytes instead of " 
+      << data.size() * sizeof(uint64_t) << ")" << endl;
+
+    t1 = chrono::high_resolution_clock::now();
+    auto ranges = present.missing_ranges(0, N);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "Missing ranges execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    bool correct = ranges.size() == 1 && ranges[0].first == d && ranges[0].count == 1 &&
+      !present.contains(d) && present.contains(d + 1) && present.rank(d + 1) == d;
+
+    // filling the hole with a union, nothing is left in the intersection
+    IdBitmap hole(&d, 1);
+    correct = correct && (present | hole).missing_ranges(0, N).empty() &&
+      (present & hole).size() == 0 && (present | hole).size() == N;
+
+    // top of the id space, bounds must not wrap
+    const uint64_t top[] = { ~0ull - 9, ~0ull };
+    IdBitmap edge(top, 2);
+    auto edgeRanges = edge.missing_ranges(~0ull - 20, ~0ull);
+    auto below = edge.missing_ranges();
+    correct = correct && edgeRanges.size() == 2 && 
+      edgeRanges[0].first == ~0ull - 20 && edgeRanges[0].count == 11 &&
+      edgeRanges[1].first == ~0ull - 8 && edgeRanges[1].count == 8 &&
+      below.size() == 2 && below[0].first == 0 && below[0].count == ~0ull - 9 &&
+      below[1].count == 8;
+
+    cout << "Missed found: " << (ranges.empty() ? 0 : ranges[0].first)
+      << (correct ? " (correct)" : " (Wrong)") << endl;
+  }
+
+
+  // ID dump on disk, scanned without loading it
+  {
+    {
+      std::ofstream out(idsPath, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(uint64_t));
+    }
+
+    t1 = chrono::high_resolution_clock::now();
+    auto fromFile = findMissedInFile(idsPath);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "File execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    cout << "Missed found: " << fromFile 
+      << (fromFile == d ? " (correct)" : " (Wrong)") << endl;
+
+    std::remove(idsPath.c_str());
+  }
+
+
+  // export corruption: the missed one is replaced by a copy of another
+  {
+    auto dup = data[12345];
+    data.push_back(dup);
+
+    t1 = chrono::high_resolution_clock::now();
+    auto single = findMismatch(data);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "Mismatch execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    t1 = chrono::high_resolution_clock::now();
+    auto parallel = findMismatchParallel(data);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "Parallel mismatch execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    {
+      std::ofstream out(idsPath, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(uint64_t));
+    }
+
+    t1 = chrono::high_resolution_clock::now();
+    auto fromFile = findMismatchInFile(idsPath);
+    t2 = chrono::high_resolution_clock::now();
+
+    cout << "File mismatch execution time: "
+      << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+      << endl;
+
+    std::remove(idsPath.c_str());
+
+    bool correct = single && parallel && fromFile &&
+      single->duplicate == dup && single->missing == d &&
+      parallel->duplicate == dup && parallel->missing == d &&
+      fromFile->duplicate == dup && fromFile->missing == d;
+
+    cout << "Duplicate found: " << (single ? single->duplicate : 0)
+      << ", missed found: " << (single ? single->missing : 0)
+      << (correct ? " (correct)" : " (Wrong)") << endl;
+  }
+
   return 0;
 }
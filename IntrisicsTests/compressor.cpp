@@ -9,20 +9,45 @@
 #include <iomanip>
 #include <limits>
 #include <memory>
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <memory_resource>
+#include <numeric>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <stdexcept>
+#include <functional>
+#include <filesystem>
 
 #include <snappy.h>
 
+#include "mapped_file.h"
+#include "perf_counter.h"
+#include "test_data.h"
+
 constexpr bool PRINT_STATS = false;
 constexpr bool PRINT_COMPRESSION_STATS = false;
 constexpr bool PRINT_PATTERNS_FREQ = false;
 
+/**
+* n values of |d|, in parallel. Value i is drawn from its own counter
+* stream, so data depends on seed only, not on threads or on how many
+* engine calls d makes.
+*/
 template <typename Dist>
-std::vector<uint32_t> generateTestData(size_t n, Dist d) {
-  std::vector<uint32_t> res;
-  res.reserve(n);
+std::vector<uint32_t> generateTestData(size_t n, Dist d, 
+  uint64_t seed = testData::DEFAULT_SEED, unsigned threads = 0) {
+  std::vector<uint32_t> res(n);
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
+  testData::parallelFill(res.data(), n, [&](size_t i) {
+    testData::Stream gen(seed, i);
+    auto local = d;
+    return (uint32_t)std::abs(local(gen));
+  }, threads);
 
   std::map<uint32_t, size_t> freq{};
 
@@ -30,17 +55,15 @@ std::vector<uint32_t> generateTestData(size_t n, Dist d) {
   uint32_t max = std::numeric_limits<uint32_t>::min();
   uint32_t aboves = 0;
 
-  for (int i = 0; i < n; ++i) {
-    res.push_back((uint32_t)std::abs(d(gen)));
-
-    if constexpr (PRINT_STATS) {
-      ++freq[res.back()];
-      if (res.back() > 65'536) {
+  if constexpr (PRINT_STATS) {
+    for (auto v : res) {
+      ++freq[v];
+      if (v > 65'536) {
         aboves++;
       }
 
-      min = std::min(min, res.back());
-      max = std::max(max, res.back());
+      min = std::min(min, v);
+      max = std::max(max, v);
     }
   }
 
@@ -73,7 +96,8 @@ std::vector<uint32_t> generateTestData(size_t n, Dist d) {
 }
 
 
-void testEqual(const std::vector<uint32_t>& l, const std::vector<uint32_t>& r) {
+template <typename L, typename R>
+void testEqual(const L& l, const R& r) {
   if (l.size() != r.size()) {
     std::cout << "Different size" << std::endl;
     return;
@@ -441,30 +465,333 @@ namespace {
   };
 }
 
+/**
+* Keeps decode buffers between requests, so repeated decodes
+* neither allocate nor memset the output.
+* Not thread safe, use one pool per worker.
+*/
+class DecodeBufferPool {
+  std::pmr::memory_resource* _mr;
+  std::vector<std::pmr::vector<uint32_t>> _free;
+
+public:
+  explicit DecodeBufferPool(
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource()) :
+    _mr(mr),
+    _free{}
+  {}
+
+  /**
+  * Returns buffer of n elements, contents are undefined.
+  * Picks the smallest free buffer with enough capacity.
+  */
+  std::pmr::vector<uint32_t> acquire(size_t n) {
+    auto best = _free.end();
+
+    for (auto it = _free.begin(); it != _free.end(); ++it) {
+      if (it->capacity() >= n &&
+        (best == _free.end() || it->capacity() < best->capacity())) {
+        best = it;
+      }
+    }
+
+    if (best == _free.end()) {
+      return std::pmr::vector<uint32_t>(n, _mr);
+    }
+
+    std::swap(*best, _free.back());
+    auto res = std::move(_free.back());
+    _free.pop_back();
+
+    // only grown tail gets zeroed
+    res.resize(n);
+    return res;
+  }
+
+  void release(std::pmr::vector<uint32_t>&& buf) {
+    _free.push_back(std::move(buf));
+  }
+
+  size_t size() const {
+    return _free.size();
+  }
+};
+
+/**
+* CRC32C (Castagnoli) with SSE4.2 crc32 instruction.
+* crc32 has 3 cycles latency and 1 cycle throughput, so data is split
+* into 3 independent streams and partial results are combined
+* with precomputed "append CRC_STRIPE zero bytes" tables.
+*/
+constexpr size_t CRC_STRIPE = 256;
+
+namespace {
+  // Raw register update, no pre/post inversion
+  uint32_t crcRaw(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t c = crc;
+
+    for (; len >= 8; len -= 8, p += 8) {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      c = _mm_crc32_u64(c, v);
+    }
+
+    for (; len > 0; --len, ++p) {
+      c = _mm_crc32_u8((uint32_t)c, *p);
+    }
+
+    return (uint32_t)c;
+  }
+
+  struct CrcShiftTable {
+    uint32_t t[4][256];
+
+    CrcShiftTable() {
+      // shift is linear over GF(2): build it from 32 basis vectors
+      const uint8_t zeros[CRC_STRIPE] = {};
+      uint32_t basis[32];
+
+      for (int i = 0; i < 32; ++i) {
+        basis[i] = crcRaw(1u << i, zeros, CRC_STRIPE);
+      }
+
+      for (int k = 0; k < 4; ++k) {
+        for (int b = 0; b < 256; ++b) {
+          uint32_t r = 0;
+          for (int i = 0; i < 8; ++i) {
+            if (b & (1 << i)) {
+              r ^= basis[k * 8 + i];
+            }
+          }
+          t[k][b] = r;
+        }
+      }
+    }
+
+    // crcRaw(crc, CRC_STRIPE zero bytes)
+    uint32_t shift(uint32_t crc) const {
+      return t[0][crc & 0xff]
+        ^ t[1][(crc >> 8) & 0xff]
+        ^ t[2][(crc >> 16) & 0xff]
+        ^ t[3][crc >> 24];
+    }
+  };
+
+  const CrcShiftTable& crcShiftTable() {
+    static const CrcShiftTable table;
+    return table;
+  }
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0) {
+  const auto* p = static_cast<const uint8_t*>(data);
+  uint32_t c = ~crc;
+
+  if (len >= 3 * CRC_STRIPE) {
+    const auto& table = crcShiftTable();
+
+    do {
+      uint64_t c0 = c;
+      uint64_t c1 = 0;
+      uint64_t c2 = 0;
+
+      for (size_t i = 0; i < CRC_STRIPE; i += 8) {
+        uint64_t v0, v1, v2;
+        memcpy(&v0, p + i, 8);
+        memcpy(&v1, p + CRC_STRIPE + i, 8);
+        memcpy(&v2, p + 2 * CRC_STRIPE + i, 8);
+
+        c0 = _mm_crc32_u64(c0, v0);
+        c1 = _mm_crc32_u64(c1, v1);
+        c2 = _mm_crc32_u64(c2, v2);
+      }
+
+      c = table.shift(table.shift((uint32_t)c0) ^ (uint32_t)c1) ^ (uint32_t)c2;
+
+      p += 3 * CRC_STRIPE;
+      len -= 3 * CRC_STRIPE;
+    } while (len >= 3 * CRC_STRIPE);
+  }
+
+  return ~crcRaw(c, p, len);
+}
+
+/**
+* On-disk format, all fields little endian:
+*
+*   [0, 64)        CompressedFileHeader
+*   [64, ...)      payload: stream words (uint32), zero padded to 64 bytes
+*   index_offset   optional block index: index_blocks uint64 bit offsets
+*                  of every block_size-th value, zero padded to 64 bytes
+*   crc table      only with COMPRESSED_FLAG_CRC32C, right after the
+*                  padded index (or payload if there is no index):
+*                  max(index_blocks, 1) uint32 CRC32C values, one per
+*                  block over the payload words the block decode reads,
+*                  zero padded to 64 bytes
+*   last 16 bytes  CompressedFileFooter
+*
+* Version 1. Readers must reject unknown versions and unknown
+* digit widths, widths are stored so they can change later.
+*/
+constexpr char COMPRESSED_MAGIC[8] = { 'I', 'T', 'C', 'M', 'P', 'R', 'S', '1' };
+constexpr uint32_t COMPRESSED_VERSION = 1;
+constexpr uint64_t COMPRESSED_ALIGN = 64;
+
+constexpr uint32_t COMPRESSED_FLAG_CRC32C = 0x1;
+
+// output overrun of SIMD store, and input over-read of padded decode
+constexpr size_t DECODE_SLACK = 16;
+constexpr size_t DECODE_INPUT_SLACK = 2;
+
+// outputs from this size (bytes) bypass the cache, see decode_streaming
+constexpr size_t STREAMING_DECODE_THRESHOLD = 8 << 20;
+constexpr size_t STREAMING_CHUNK = 2048;
+
+enum class DecodeStatus {
+  Ok,
+  Truncated,    // stream ends before all values are decoded
+  Corrupted     // lengths don't match, or checksum mismatch
+};
+
+/**
+* Output conversions for decode_optimized_impl.
+* store() converts 16 decoded lanes in register and writes them,
+* operator() converts a single value on the scalar paths.
+* Both must give the same result for the same value.
+*/
+struct DecodeAsU32 {
+  using type = uint32_t;
+
+  void store(uint32_t* out, __m512i v) const {
+    _mm512_storeu_si512(out, v);
+  }
+
+  uint32_t operator()(uint32_t v) const {
+    return v;
+  }
+};
+
+// zero extension, for sums that overflow uint32
+struct DecodeAsU64 {
+  using type = uint64_t;
+
+  void store(uint64_t* out, __m512i v) const {
+    _mm512_storeu_si512(out, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(v)));
+    _mm512_storeu_si512(out + 8, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+  }
+
+  uint64_t operator()(uint32_t v) const {
+    return v;
+  }
+};
+
+// fixed point to floating: value * scale
+template <typename T>
+struct DecodeScaled {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>,
+    "float or double output only");
+
+  using type = T;
+  T scale;
+
+  void store(T* out, __m512i v) const {
+    if constexpr (std::is_same_v<T, float>) {
+      _mm512_storeu_ps(out, _mm512_mul_ps(_mm512_cvtepu32_ps(v), _mm512_set1_ps(scale)));
+    }
+    else {
+      auto s = _mm512_set1_pd(scale);
+      _mm512_storeu_pd(out, 
+        _mm512_mul_pd(_mm512_cvtepu32_pd(_mm512_castsi512_si256(v)), s));
+      _mm512_storeu_pd(out + 8, 
+        _mm512_mul_pd(_mm512_cvtepu32_pd(_mm512_extracti64x4_epi64(v, 1)), s));
+    }
+  }
+
+  T operator()(uint32_t v) const {
+    return (T)v * scale;
+  }
+};
+
+struct CompressedFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint8_t widths[4];        // digit length for every 2-bit mask
+  uint32_t block_size;      // values per index entry, 0 - no index
+  uint64_t digits;          // values count
+  uint64_t bits;            // stream length
+  uint64_t words;           // payload length in uint32
+  uint64_t index_offset;    // from file start, 0 - no index
+  uint64_t index_blocks;
+};
+
+struct CompressedFileFooter {
+  uint64_t file_size;
+  char magic[8];
+};
+
+static_assert(sizeof(CompressedFileHeader) == COMPRESSED_ALIGN, 
+  "Header must keep payload aligned");
+static_assert(sizeof(CompressedFileFooter) == 16, "Footer layout");
+
 class Compressed {
   uint64_t _bits;
   uint64_t _digits;
-  std::vector<uint32_t> _data;
+  std::pmr::vector<uint32_t> _data;
 
-  void flush(
+public:
+  /**
+  * Unconditionally store the whole 64-bit buffer (high half first, as
+  * decoders expect) and advance only if the high word is complete.
+  * The low word is overwritten by the next store, so the output
+  * needs one spare word after the last complete one.
+  * Other codecs use it too, to share the word layout.
+  */
+  static void flush(
+    uint32_t*& out,
     uint64_t& buf,
     uint8_t& bbits) {
-    if (bbits >= 32) {
-      _data.push_back((uint32_t)(buf >> 32));
-      buf <<= 32;
-      bbits -= 32;
-      _bits += 32;
+    uint64_t w = _rotl64(buf, 32);
+    memcpy(out, &w, sizeof(w));
+
+    // bbits < 64 here, so full is 0 or 1
+    const uint8_t full = bbits >> 5;
+    out += full;
+    buf <<= full << 5;
+    bbits -= full << 5;
+  }
+
+  /**
+  * Worst case: 2 bit mask + 32 bit digit per value and a spare word
+  * for the last unconditional store
+  */
+  static size_t max_encoded_words(size_t n) {
+    // (n * 34 + 31) / 32 without overflow of n * 34
+    return n + (n + 15) / 16 + 1;
+  }
+
+  /**
+  * Exact size from lzcnt classes, no writes.
+  * Much tighter than max_encoded_words for small values.
+  */
+  static size_t encoded_words(const uint32_t* v, size_t n) {
+    uint64_t bits = 2 * n;
+    for (size_t i = 0; i < n; ++i) {
+      bits += lz_to_length[__lzcnt(v[i])];
     }
+
+    return (bits + 31) / 32 + 1;
   }
 
-public:
-  explicit Compressed(const std::vector<uint32_t>& v) :
-    _bits(0),
-    _digits(v.size()),
-    _data{}
-  {
+  /**
+  * Encode n values into caller provided memory, no allocations.
+  * out must hold at least encoded_words(v, n) words.
+  * Returns number of bits written.
+  */
+  static uint64_t encode(const uint32_t* v, size_t n, uint32_t* out) {
     uint64_t buf = 0;
     uint8_t bbits = 0;
+    uint32_t* o = out;
 
     std::map<uint64_t, size_t> freq{};
     std::map<uint8_t, size_t> t4_freq{};
@@ -476,7 +803,8 @@ public:
     uint8_t t2 = 0;
     
 
-    for (uint32_t num : v) {
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t num = v[i];
       auto lz = __lzcnt(num);
       
       /**
@@ -506,7 +834,7 @@ public:
       // 2 bits (64-2) shifted by allocated space
       buf |= lz_to_code[lz] << (62 - bbits);
       bbits += 2;
-      flush(buf, bbits);
+      flush(o, buf, bbits);
 
       /**
       * Append digit
@@ -515,13 +843,10 @@ public:
       // Cast to 64-bit for shift
       buf |= ((uint64_t)num) << (64 - lz_to_length[lz] - bbits);
       bbits += lz_to_length[lz];
-      flush(buf, bbits);
+      flush(o, buf, bbits);
     }
 
-    if (bbits > 0) {
-      _data.push_back((uint32_t)(buf >> 32));
-      _bits += bbits;
-    }
+    // tail word is already stored by the last flush
 
     if constexpr (PRINT_COMPRESSION_STATS) {
       for (const auto& p : freq) {
@@ -568,22 +893,141 @@ public:
         std::cout << (int)p.first << ": " << p.second << " times" << std::endl;
       }
     }
+
+    return (o - out) * 32ull + bbits;
   }
 
-  std::vector<uint32_t> decompress() const {
-    std::vector<uint32_t> res;
-    res.reserve(_digits);
+  /**
+  * Stream memory comes from mr, pass std::pmr::monotonic_buffer_resource
+  * to build many short lived blocks and drop them with one release()
+  */
+  explicit Compressed(
+    const std::vector<uint32_t>& v,
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource()) :
+    _bits(0),
+    _digits(v.size()),
+    _data(encoded_words(v.data(), v.size()), mr)
+  {
+    _bits = encode(v.data(), v.size(), _data.data());
+
+    // drop spare word, single trim, no reallocation
+    _data.resize((_bits + 31) / 32);
+  }
+
+  // empty stream, to be filled by append
+  explicit Compressed(std::pmr::memory_resource* mr) :
+    _bits(0),
+    _digits(0),
+    _data(mr)
+  {}
+
+  /**
+  * dst[0] keeps its high bits and gets src >> s in the rest,
+  * every next dst word is the funnel shift of two src words.
+  * Writes out words after dst[0], out <= m.
+  */
+  static void splice(
+    uint32_t* dst, 
+    const uint32_t* src, 
+    size_t m, 
+    size_t out, 
+    uint8_t s) {
+    dst[0] |= src[0] >> s;
+
+    const auto sl = _mm_cvtsi32_si128(32 - s);
+    const auto sr = _mm_cvtsi32_si128(s);
+
+    size_t k = 1;
+    for (; k + 16 <= out && k + 16 <= m; k += 16) {
+      auto prev = _mm512_loadu_si512(src + k - 1);
+      auto cur = _mm512_loadu_si512(src + k);
+
+      auto w = _mm512_or_si512(
+        _mm512_sll_epi32(prev, sl),
+        _mm512_srl_epi32(cur, sr));
+
+      _mm512_storeu_si512(dst + k, w);
+    }
+
+    for (; k <= out; ++k) {
+      dst[k] = (src[k - 1] << (32 - s)) | (k < m ? src[k] >> s : 0);
+    }
+  }
+
+  /**
+  * Splice other stream right after the last bit of this one.
+  * Streams are plain tag+digit sequences, so no decode or encode needed.
+  */
+  void append(const Compressed& other) {
+    if (&other == this) {
+      const Compressed copy(*this);
+      append(copy);
+      return;
+    }
+
+    const uint64_t total = _bits + other._bits;
+    const size_t first = _data.size();
+    const uint8_t s = _bits & 31;
+
+    _data.resize((total + 31) / 32);
 
+    if (s == 0) {
+      std::copy(other._data.begin(), other._data.end(), _data.begin() + first);
+    }
+    else if (other._bits > 0) {
+      splice(_data.data() + first - 1, other._data.data(), other._data.size(), 
+        _data.size() - first, s);
+    }
+
+    _bits = total;
+    _digits += other._digits;
+  }
+
+  /**
+  * Single allocation for all parts
+  */
+  static Compressed concat(
+    const Compressed* parts, 
+    size_t count,
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource()) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+      bits += parts[i]._bits;
+    }
+
+    Compressed res(mr);
+    res._data.reserve((bits + 31) / 32);
+
+    for (size_t i = 0; i < count; ++i) {
+      res.append(parts[i]);
+    }
+
+    return res;
+  }
 
-    auto it = std::begin(_data);
+  /**
+  * Decode n values from raw stream into caller provided memory.
+  * skip - bit offset of the first value inside *it (block index)
+  */
+  static void decode(
+    const uint32_t* it, 
+    uint64_t n, 
+    uint32_t* rit, 
+    uint8_t skip = 0) {
 
     // todo: try to use 128 bit buffer and use one 'if' per circle
     uint64_t buf = 0;
     uint8_t bbits = 0;
 
+    if (skip) {
+      buf = ((uint64_t)*it) << (32 + skip);
+      bbits = 32 - skip;
+      ++it;
+    }
+
 
 
-    for (size_t i = 0; i < _digits; ++i) {
+    for (size_t i = 0; i < n; ++i) {
       if (bbits < 2) {
         buf |= ((uint64_t)*it) << (32 - bbits);
         bbits += 32;
@@ -600,31 +1044,54 @@ public:
         ++it;
       }
 
-      res.push_back(buf >> (64 - len));
+      *rit = buf >> (64 - len);
+      ++rit;
       buf <<= len;
       bbits -= len;
     }
-
-    return res;
   }
 
-  std::vector<uint32_t> decompress_optimized() {
-    std::vector<uint32_t> res;
-    // NB resize here, cause we will store mm512 in allocated memory 
-    // todo: how to do it without memset(0) ?
-    res.resize(_digits);
-
-    auto it = std::begin(_data);
-    auto rit = std::begin(res);
-
+  /**
+  * AVX-512 decoder. Checked version never reads at or past end,
+  * and verifies that exactly bits were consumed.
+  * Padded version stays in SIMD loop up to the last value: input 
+  * must be followed by DECODE_INPUT_SLACK readable words and output
+  * must hold n + DECODE_SLACK values.
+  * Out converts values before they are stored, see DecodeAsU32.
+  * consumed - if set, receives stream bits read for n values.
+  */
+  template <bool Checked, bool Padded = false, typename Out = DecodeAsU32>
+  static DecodeStatus decode_optimized_impl(
+    const uint32_t* it,
+    const uint32_t* end,
+    uint64_t n,
+    uint64_t bits,
+    typename Out::type* rit,
+    uint8_t skip,
+    Out out = Out(),
+    uint64_t* consumed = nullptr) {
+    const uint32_t* start = it;
     size_t i = 0;
 
     uint64_t buf = 0;
     uint8_t bbits = 0;
 
+    if constexpr (Checked) {
+      if (n > 0 && it == end) {
+        return DecodeStatus::Truncated;
+      }
+    }
+
+    if (skip) {
+      buf = ((uint64_t)*it) << (32 + skip);
+      bbits = 32 - skip;
+      ++it;
+    }
+
     // decode optimized
     // left 16 digits to garantee no memory access violation 
-    for (; i + 16 < _digits;) {
+    // checked: single iteration reads at most 2 words
+    for (; (Padded ? i < n : i + 16 < n) && (!Checked || end - it >= 2);) {
       if (bbits < 32) {
         buf |= ((uint64_t)*it) << (32 - bbits);
         bbits += 32;
@@ -650,8 +1117,8 @@ public:
         auto digits = _mm512_and_epi32(buf_copy, DIGIT_MASKS[tz]);
         auto shifted = _mm512_srav_epi32(digits, SHIFT_MASKS[tz]);
 
-        _mm512_store_epi32(&(*rit), shifted);
-        std::advance(rit, DIGITS_DECOMPRESSED[tz]);
+        out.store(rit, shifted);
+        rit += DIGITS_DECOMPRESSED[tz];
         i += DIGITS_DECOMPRESSED[tz];
 
         buf <<= BITS_SPENT[tz];
@@ -666,7 +1133,7 @@ public:
           ++it;
         }
 
-        *rit = buf >> 32;
+        *rit = out((uint32_t)(buf >> 32));
         ++rit;
         buf <<= 32;
         bbits -= 32;
@@ -675,8 +1142,14 @@ public:
     }
 
     // decode rest
-    for (; i < _digits; ++i) {
+    for (; i < n; ++i) {
       if (bbits < 2) {
+        if constexpr (Checked) {
+          if (it == end) {
+            return DecodeStatus::Truncated;
+          }
+        }
+
         buf |= ((uint64_t)*it) << (32 - bbits);
         bbits += 32;
         ++it;
@@ -687,162 +1160,2937 @@ public:
       bbits -= 2;
 
       if (bbits < len) {
+        if constexpr (Checked) {
+          if (it == end) {
+            return DecodeStatus::Truncated;
+          }
+        }
+
         buf |= ((uint64_t)*it) << (32 - bbits);
         bbits += 32;
         ++it;
       }
 
-      *rit = buf >> (64 - len);
+      *rit = out((uint32_t)(buf >> (64 - len)));
       ++rit;
       buf <<= len;
       bbits -= len;
     }
 
-    return res;
+    if (consumed) {
+      *consumed = (it - start) * 32ull - skip - bbits;
+    }
+
+    if constexpr (Checked) {
+      if ((it - start) * 32ull - skip - bbits != bits) {
+        return DecodeStatus::Corrupted;
+      }
+    }
+
+    return DecodeStatus::Ok;
   }
 
-  uint64_t bits() const {
-    return _bits;
+  /**
+  * Same as decode, but with AVX-512 pattern matching.
+  * Stores full 512 bit vectors, but never past out + n.
+  */
+  static void decode_optimized(
+    const uint32_t* it, 
+    uint64_t n, 
+    uint32_t* rit, 
+    uint8_t skip = 0) {
+    decode_optimized_impl<false>(it, nullptr, n, 0, rit, skip);
   }
 
-};
+  /**
+  * Decode and convert in one pass, e.g. DecodeAsU64 or 
+  * DecodeScaled<double>{ 0.01 }. Same store bounds as decode_optimized.
+  */
+  template <typename Out>
+  static void decode_as(
+    const uint32_t* it, 
+    uint64_t n, 
+    typename Out::type* rit, 
+    Out out,
+    uint8_t skip = 0) {
+    decode_optimized_impl<false, false, Out>(it, nullptr, n, 0, rit, skip, out);
+  }
 
+  /**
+  * Decode for outputs much larger than the cache, which are consumed
+  * later by someone else. Values are decoded in STREAMING_CHUNK pieces
+  * into L1-resident staging and copied out with aligned non-temporal
+  * stores, so output doesn't evict neighbours from LLC and there are
+  * no read-for-ownership loads. Overlapping unaligned stores of the
+  * SIMD loop can't be streamed directly.
+  * Never stores past out + n.
+  */
+  static void decode_streaming(
+    const uint32_t* it, 
+    uint64_t n, 
+    uint32_t* rit) {
+    alignas(64) uint32_t stage[STREAMING_CHUNK + DECODE_SLACK];
+
+    uint64_t pos = 0;
+    uint64_t done = 0;
+
+    auto next = [&](uint32_t* out, uint64_t count) {
+      uint64_t spent = 0;
+      decode_optimized_impl<false>(it + (pos >> 5), nullptr, count, 0, 
+        out, pos & 31, DecodeAsU32(), &spent);
+      pos += spent;
+      done += count;
+    };
+
+    // up to the first 64 byte boundary with regular stores
+    auto head = std::min<uint64_t>(n, ((64 - ((uintptr_t)rit & 63)) & 63) / 4);
+    if (head) {
+      next(rit, head);
+    }
 
+    while (done < n) {
+      auto count = std::min<uint64_t>(n - done, STREAMING_CHUNK);
+      auto* dst = rit + done;
+      next(stage, count);
 
-int main()
-{
-  auto td1 = generateTestData(10'000'000,  
-    std::cauchy_distribution<>{4.0, 2.0});
-  auto td2 = generateTestData(10'000'000,
-    std::cauchy_distribution<>{8.0, 8.0});
-  auto td3 = generateTestData(10'000'000,
-    std::cauchy_distribution<>{8.0, 16.0});
-  auto td4 = generateTestData(10'000'000,
-    std::cauchy_distribution<>{16.0, 16.0});
-  auto td5 = generateTestData(10'000'000,
-    std::cauchy_distribution<>{1000.0, 1000.0});
+      size_t j = 0;
+      for (; j + 16 <= count; j += 16) {
+        _mm512_stream_si512((__m512i*)(dst + j), _mm512_load_si512(stage + j));
+      }
 
-  std::cout << " _______ " << std::endl;
-  std::cout << std::endl;
-  std::cout << " ** Compressing ** " << std::endl;
-  std::cout << " _______ " << std::endl;
-  std::cout << std::endl;
+      memcpy(dst + j, stage + j, (count - j) * sizeof(uint32_t));
+    }
 
+    _mm_sfence();
+  }
 
-  for (const auto* const td : 
-    std::vector<const decltype(td1)*>{ 
-            &td1, &td2, &td3, &td4, &td5 
-    }) {
+  /**
+  * Decode short stream without scalar tail, see decode_optimized_impl
+  * for padding requirements
+  */
+  static void decode_padded(
+    const uint32_t* it, 
+    uint64_t n, 
+    uint32_t* rit) {
+    decode_optimized_impl<false, true>(it, nullptr, n, 0, rit, 0);
+  }
 
-    auto t1 = std::chrono::high_resolution_clock::now();
-    Compressed cd(*td);
-    auto t2 = std::chrono::high_resolution_clock::now();
-    auto ct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+  /**
+  * Decoder for untrusted input: words available, n values and
+  * bits length come from the outside and are checked against each other.
+  * Bulk goes through the same SIMD loop, only the last few words 
+  * are decoded with guarded loads.
+  */
+  static DecodeStatus decode_checked(
+    const uint32_t* it, 
+    uint64_t words, 
+    uint64_t n, 
+    uint64_t bits,
+    uint32_t* rit, 
+    uint8_t skip = 0) {
+    if (skip >= 32 || words > (1ull << 58) || bits > (1ull << 62) || 
+      bits + skip > words * 32) {
+      return DecodeStatus::Truncated;
+    }
 
-    std::cout << "* Original:\t";
-    std::cout << "[\t" 
-      << td1.size() * 32 << " bit,\t"
-      << td1.size() * 4 << " b,\t"
-      << td1.size() / 256 << " Kb]"
-      << std::endl;
+    // every value takes from 6 to 34 bits, n comes from the header,
+    // so no n * 34
+    if (n > bits / 6 || bits / 34 > n) {
+      return DecodeStatus::Corrupted;
+    }
 
+    return decode_optimized_impl<true>(it, it + words, n, bits, rit, skip);
+  }
 
-    std::cout << "* Compressed:\t";
-    std::cout << "[\t"
-      << cd.bits() << " bit,\t"
-      << cd.bits() / 8 << " b,\t"
-      << cd.bits() / 8'192 << " Kb] "
-      << std::endl;
+  std::vector<uint32_t> decompress() const {
+    std::vector<uint32_t> res(_digits);
+    decode(_data.data(), _digits, res.data());
+    return res;
+  }
 
-    /*
+  /**
+  * out must hold digits() values. Outputs over
+  * STREAMING_DECODE_THRESHOLD bytes use decode_streaming.
+  */
+  void decompress_to(uint32_t* out) const {
+    if (_digits * sizeof(uint32_t) >= STREAMING_DECODE_THRESHOLD) {
+      decode_streaming(_data.data(), _digits, out);
+    }
+    else {
+      decode_optimized(_data.data(), _digits, out);
+    }
+  }
 
-    snappy compression
+  std::vector<uint32_t> decompress_optimized() const {
+    std::vector<uint32_t> res;
+    // NB resize here, cause we will store mm512 in allocated memory 
+    // todo: how to do it without memset(0) ? (see DecodeBufferPool)
+    res.resize(_digits);
+    decompress_to(res.data());
+    return res;
+  }
 
-    */
-    std::string snappy_compressed;
+  /**
+  * Large output mode: uninitialized huge page memory, 
+  * filled through decompress_to
+  */
+  HugePageMemory decompress_large() const {
+    HugePageMemory res(_digits * sizeof(uint32_t));
+    decompress_to(res.as<uint32_t>());
+    return res;
+  }
 
+  template <typename Out>
+  std::vector<typename Out::type> decompress_as(Out out = Out()) const {
+    std::vector<typename Out::type> res(_digits);
+    decode_as(_data.data(), _digits, res.data(), out);
+    return res;
+  }
 
-    t1 = std::chrono::high_resolution_clock::now();
-    auto csize = snappy::Compress(reinterpret_cast<const char*>(&(*td->begin())), td->size() * 4, &snappy_compressed);
-    t2 = std::chrono::high_resolution_clock::now();
+  DecodeStatus decompress_checked(std::vector<uint32_t>& res) const {
+    res.resize(_digits);
+    return decode_checked(_data.data(), _data.size(), _digits, _bits, res.data());
+  }
 
-    auto sct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+  /**
+  * Decode into buffer taken from pool, give it back with pool.release()
+  */
+  std::pmr::vector<uint32_t> decompress_optimized(DecodeBufferPool& pool) const {
+    auto res = pool.acquire(_digits);
+    decompress_to(res.data());
+    return res;
+  }
 
-    std::cout << "* Snappy:\t";
-    std::cout << "[\t"
-      << csize * 8 << " bit,\t"
-      << csize << " b,\t"
-      << csize / 1024 << " Kb]"
-      << std::endl;
+  /**
+  * Bit offset of every block-th value, walks 2-bit masks only.
+  * Any block can be decoded alone with
+  * decode(data + (off >> 5), count, out, off & 31)
+  */
+  static std::vector<uint64_t> block_offsets(
+    const uint32_t* data, 
+    uint64_t words, 
+    uint64_t n, 
+    uint32_t block) {
+    std::vector<uint64_t> res;
+    res.reserve((n + block - 1) / block);
+
+    uint64_t pos = 0;
+
+    for (uint64_t i = 0; i < n; ++i) {
+      if (i % block == 0) {
+        res.push_back(pos);
+      }
 
-    std::cout << std::endl;
+      auto w = pos >> 5;
+      uint64_t window = ((uint64_t)data[w]) << 32;
+      if (w + 1 < words) {
+        window |= data[w + 1];
+      }
 
-    std::cout << "       Compression time:\t\t" << ct << std::endl;
-    std::cout << "Snappy compression time:\t\t" << sct << std::endl;
-    std::cout << std::endl;
+      pos += 2 + mask_to_length[(window << (pos & 31)) >> 62];
+    }
 
+    return res;
+  }
 
+  std::vector<uint64_t> block_offsets(uint32_t block) const {
+    return block_offsets(_data.data(), _data.size(), _digits, block);
+  }
 
-    t1 = std::chrono::high_resolution_clock::now();
-    auto dd = cd.decompress();
-    t2 = std::chrono::high_resolution_clock::now();
+  /**
+  * Write stream in CompressedFileHeader format.
+  * block_size = 0 - no block index
+  * checksum - CRC32C per block (per file without index)
+  */
+  void save(
+    const std::string& path, 
+    uint32_t block_size = 0, 
+    bool checksum = false) const;
+
+  /**
+  * Same format in memory: offsets only, no pointers,
+  * so it can be placed in shared memory and mapped anywhere.
+  * dst must hold layout_size() bytes and be 64 byte aligned.
+  */
+  size_t layout_size(uint32_t block_size = 0, bool checksum = false) const;
+  void write_layout(uint8_t* dst, uint32_t block_size = 0, bool checksum = false) const;
+
+  uint64_t digits() const {
+    return _digits;
+  }
 
-    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+  uint64_t bits() const {
+    return _bits;
+  }
 
+  const std::pmr::vector<uint32_t>& data() const {
+    return _data;
+  }
 
+};
 
-    t1 = std::chrono::high_resolution_clock::now();
-    auto ddo = cd.decompress_optimized();
-    t2 = std::chrono::high_resolution_clock::now();
 
-    auto odt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
+namespace {
+  uint64_t alignUp(uint64_t v) {
+    return (v + COMPRESSED_ALIGN - 1) / COMPRESSED_ALIGN * COMPRESSED_ALIGN;
+  }
 
-    std::vector<uint32_t> sd(td->size());
-    std::string uncompressed;
+  void writePadding(std::ofstream& out, uint64_t written) {
+    static const char zeros[COMPRESSED_ALIGN] = {};
+    out.write(zeros, alignUp(written) - written);
+  }
+
+  /**
+  * Payload words [first, last) read by decode of block b
+  */
+  std::pair<uint64_t, uint64_t> blockWords(
+    const uint64_t* index, 
+    size_t blocks, 
+    uint64_t words, 
+    size_t b) {
+    if (index == nullptr) {
+      return { 0, words };
+    }
+
+    return {
+      index[b] >> 5,
+      b + 1 < blocks ? (index[b + 1] + 31) >> 5 : words
+    };
+  }
+}
+
+namespace {
+  /**
+  * Everything but the payload, offsets are final
+  */
+  struct LayoutParts {
+    CompressedFileHeader header;
+    std::vector<uint64_t> index;
+    std::vector<uint32_t> crcs;
+    CompressedFileFooter footer;
+  };
+
+  LayoutParts buildLayout(const Compressed& c, uint32_t block_size, bool checksum) {
+    LayoutParts l{};
+    const auto& data = c.data();
+
+    if (block_size > 0) {
+      l.index = c.block_offsets(block_size);
+    }
+
+    if (checksum) {
+      const size_t n = std::max<size_t>(l.index.size(), 1);
+      l.crcs.reserve(n);
+
+      for (size_t b = 0; b < n; ++b) {
+        auto w = blockWords(
+          l.index.empty() ? nullptr : l.index.data(), l.index.size(), data.size(), b);
+        l.crcs.push_back(crc32c(data.data() + w.first, (w.second - w.first) * sizeof(uint32_t)));
+      }
+    }
+
+    auto& h = l.header;
+    memcpy(h.magic, COMPRESSED_MAGIC, sizeof(h.magic));
+    h.version = COMPRESSED_VERSION;
+    h.flags = checksum ? COMPRESSED_FLAG_CRC32C : 0;
+    memcpy(h.widths, mask_to_length, sizeof(h.widths));
+    h.block_size = block_size;
+    h.digits = c.digits();
+    h.bits = c.bits();
+    h.words = data.size();
+
+    uint64_t payload_end = sizeof(h) + alignUp(h.words * sizeof(uint32_t));
+
+    h.index_offset = l.index.empty() ? 0 : payload_end;
+    h.index_blocks = l.index.size();
+
+    l.footer.file_size = payload_end 
+      + alignUp(l.index.size() * sizeof(uint64_t)) 
+      + alignUp(l.crcs.size() * sizeof(uint32_t))
+      + sizeof(l.footer);
+    memcpy(l.footer.magic, COMPRESSED_MAGIC, sizeof(l.footer.magic));
+
+    return l;
+  }
+}
+
+void Compressed::save(
+  const std::string& path, 
+  uint32_t block_size, 
+  bool checksum) const {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Can't create " + path);
+  }
+
+  const auto l = buildLayout(*this, block_size, checksum);
+
+  out.write(reinterpret_cast<const char*>(&l.header), sizeof(l.header));
+
+  out.write(reinterpret_cast<const char*>(_data.data()), _data.size() * sizeof(uint32_t));
+  writePadding(out, _data.size() * sizeof(uint32_t));
+
+  out.write(reinterpret_cast<const char*>(l.index.data()), l.index.size() * sizeof(uint64_t));
+  writePadding(out, l.index.size() * sizeof(uint64_t));
+
+  out.write(reinterpret_cast<const char*>(l.crcs.data()), l.crcs.size() * sizeof(uint32_t));
+  writePadding(out, l.crcs.size() * sizeof(uint32_t));
+
+  out.write(reinterpret_cast<const char*>(&l.footer), sizeof(l.footer));
+
+  if (!out) {
+    throw std::runtime_error("Can't write " + path);
+  }
+}
+
+size_t Compressed::layout_size(uint32_t block_size, bool checksum) const {
+  const uint64_t blocks = block_size > 0 ? (_digits + block_size - 1) / block_size : 0;
+
+  return sizeof(CompressedFileHeader)
+    + alignUp(_data.size() * sizeof(uint32_t))
+    + alignUp(blocks * sizeof(uint64_t))
+    + (checksum ? alignUp(std::max<uint64_t>(blocks, 1) * sizeof(uint32_t)) : 0)
+    + sizeof(CompressedFileFooter);
+}
+
+void Compressed::write_layout(uint8_t* dst, uint32_t block_size, bool checksum) const {
+  const auto l = buildLayout(*this, block_size, checksum);
+
+  // padding must be zero, same bytes as save()
+  memset(dst, 0, l.footer.file_size);
+
+  uint8_t* p = dst;
+  memcpy(p, &l.header, sizeof(l.header));
+  p += sizeof(l.header);
+
+  memcpy(p, _data.data(), _data.size() * sizeof(uint32_t));
+  p += alignUp(_data.size() * sizeof(uint32_t));
+
+  memcpy(p, l.index.data(), l.index.size() * sizeof(uint64_t));
+  p += alignUp(l.index.size() * sizeof(uint64_t));
+
+  memcpy(p, l.crcs.data(), l.crcs.size() * sizeof(uint32_t));
+  p += alignUp(l.crcs.size() * sizeof(uint32_t));
+
+  memcpy(p, &l.footer, sizeof(l.footer));
+}
+
+
+/**
+* Compressed column decoded straight from its serialized bytes
+* (mapped file, shared memory). Checks header, footer and table
+* bounds only, so attach is O(1) regardless of column size.
+* Bytes may be followed by padding (page rounded mappings).
+*/
+class CompressedLayout {
+  const CompressedFileHeader* _header;
+  const uint32_t* _data;
+  const uint64_t* _index;
+  const uint32_t* _crc;
+
+protected:
+  CompressedLayout() :
+    _header(nullptr),
+    _data(nullptr),
+    _index(nullptr),
+    _crc(nullptr)
+  {}
+
+  void attach(const uint8_t* base, size_t size, const std::string& name) {
+    if (size < sizeof(CompressedFileHeader) + sizeof(CompressedFileFooter)) {
+      throw std::runtime_error("Truncated column: " + name);
+    }
+
+    _header = reinterpret_cast<const CompressedFileHeader*>(base);
+
+    if (memcmp(_header->magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0) {
+      throw std::runtime_error("Not a compressed column: " + name);
+    }
+
+    if (_header->version != COMPRESSED_VERSION ||
+      memcmp(_header->widths, mask_to_length, sizeof(mask_to_length)) != 0) {
+      throw std::runtime_error("Unsupported format version: " + name);
+    }
+
+    if (_header->words > size / sizeof(uint32_t) ||
+      _header->bits > _header->words * 32 ||
+      (_header->words * 32 - _header->bits) >= 32 ||
+      _header->digits > _header->bits / 6) {
+      throw std::runtime_error("Corrupted header: " + name);
+    }
+
+    const uint64_t payload_end = sizeof(CompressedFileHeader)
+      + alignUp(_header->words * sizeof(uint32_t));
+    uint64_t end = payload_end;
+
+    _data = reinterpret_cast<const uint32_t*>(base + sizeof(CompressedFileHeader));
+
+    if (_header->index_offset != 0) {
+      if (_header->block_size == 0 ||
+        _header->index_offset < payload_end ||
+        _header->index_offset > size ||
+        _header->index_offset % COMPRESSED_ALIGN != 0 ||
+        _header->index_blocks > (size - _header->index_offset) / sizeof(uint64_t) ||
+        _header->index_blocks != 
+          (_header->digits + _header->block_size - 1) / _header->block_size) {
+        throw std::runtime_error("Corrupted block index: " + name);
+      }
+
+      _index = reinterpret_cast<const uint64_t*>(base + _header->index_offset);
+      end = _header->index_offset + alignUp(_header->index_blocks * sizeof(uint64_t));
+    }
+    else if (_header->index_blocks != 0) {
+      throw std::runtime_error("Corrupted block index: " + name);
+    }
+
+    if (_header->flags & COMPRESSED_FLAG_CRC32C) {
+      // count comes from the header, so no checksums() * 4
+      const uint64_t body = size - sizeof(CompressedFileFooter);
+      if (end > body || checksums() > (body - end) / sizeof(uint32_t)) {
+        throw std::runtime_error("Corrupted checksums: " + name);
+      }
+
+      _crc = reinterpret_cast<const uint32_t*>(base + end);
+      end += alignUp(checksums() * sizeof(uint32_t));
+    }
+
+    end += sizeof(CompressedFileFooter);
+
+    if (end > size) {
+      throw std::runtime_error("Truncated column: " + name);
+    }
+
+    const auto* footer = reinterpret_cast<const CompressedFileFooter*>(
+      base + end - sizeof(CompressedFileFooter));
+
+    if (memcmp(footer->magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0 ||
+      footer->file_size != end) {
+      throw std::runtime_error("Corrupted footer: " + name);
+    }
+  }
+
+public:
+  CompressedLayout(const uint8_t* base, size_t size, const std::string& name) :
+    CompressedLayout()
+  {
+    attach(base, size, name);
+  }
+
+  uint64_t digits() const {
+    return _header->digits;
+  }
+
+  uint64_t bits() const {
+    return _header->bits;
+  }
+
+  const uint32_t* data() const {
+    return _data;
+  }
+
+  bool has_index() const {
+    return _index != nullptr;
+  }
+
+  uint32_t block_size() const {
+    return _header->block_size;
+  }
+
+  size_t blocks() const {
+    return _header->index_blocks;
+  }
+
+  bool has_checksums() const {
+    return _crc != nullptr;
+  }
+
+  // one per block, single one for whole payload without index
+  size_t checksums() const {
+    return std::max<size_t>(_header->index_blocks, 1);
+  }
+
+  /**
+  * Check CRC32C of block b, true if file has no checksums
+  */
+  bool verify_block(size_t b) const {
+    if (_crc == nullptr) {
+      return true;
+    }
+
+    // index is not covered by checksums, a broken one must not send us out of payload
+    auto w = blockWords(_index, _header->index_blocks, _header->words, b);
+    if (w.first > w.second || w.second > _header->words) {
+      return false;
+    }
+
+    return crc32c(_data + w.first, (w.second - w.first) * sizeof(uint32_t)) == _crc[b];
+  }
+
+  bool verify() const {
+    for (size_t b = 0; b < checksums(); ++b) {
+      if (!verify_block(b)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+  * Verify and decode block by block, so every block is checked
+  * right before decode while its words are still in cache.
+  * Returns false on first checksum mismatch, out is undefined then.
+  */
+  bool decompress_verified(uint32_t* out) const {
+    if (_index == nullptr) {
+      if (!verify()) {
+        return false;
+      }
+
+      decompress_optimized(out);
+      return true;
+    }
+
+    for (size_t b = 0; b < blocks(); ++b) {
+      if (!verify_block(b)) {
+        return false;
+      }
+
+      out += decode_block(b, out);
+    }
+
+    return true;
+  }
+
+  /**
+  * out must hold digits() values
+  */
+  void decompress_optimized(uint32_t* out) const {
+    if (_header->digits * sizeof(uint32_t) >= STREAMING_DECODE_THRESHOLD) {
+      Compressed::decode_streaming(_data, _header->digits, out);
+    }
+    else {
+      Compressed::decode_optimized(_data, _header->digits, out);
+    }
+  }
+
+  std::vector<uint32_t> decompress_optimized() const {
+    std::vector<uint32_t> res(_header->digits);
+    decompress_optimized(res.data());
+    return res;
+  }
+
+  /**
+  * Decode single block using the index, returns values count.
+  * out must hold block_size() values
+  */
+  size_t decode_block(size_t b, uint32_t* out) const {
+    const uint64_t first = (uint64_t)b * _header->block_size;
+    const uint64_t n = std::min<uint64_t>(_header->block_size, _header->digits - first);
+    const uint64_t off = _index[b];
+
+    Compressed::decode_optimized(_data + (off >> 5), n, out, off & 31);
+    return n;
+  }
+
+  /**
+  * Bounds safe full decode for files from untrusted sources
+  */
+  DecodeStatus decompress_checked(uint32_t* out) const {
+    return Compressed::decode_checked(
+      _data, _header->words, _header->digits, _header->bits, out);
+  }
+
+  /**
+  * Bounds safe block decode, index entries are checked too.
+  * n - decoded values count on success
+  */
+  DecodeStatus decode_block_checked(size_t b, uint32_t* out, size_t& n) const {
+    if (_index == nullptr || b >= blocks()) {
+      return DecodeStatus::Corrupted;
+    }
+
+    const uint64_t first = (uint64_t)b * _header->block_size;
+    const uint64_t off = _index[b];
+    const uint64_t next = b + 1 < blocks() ? _index[b + 1] : _header->bits;
+
+    if (off > next || next > _header->bits) {
+      return DecodeStatus::Corrupted;
+    }
+
+    n = std::min<uint64_t>(_header->block_size, _header->digits - first);
+
+    return Compressed::decode_checked(
+      _data + (off >> 5), _header->words - (off >> 5), n, next - off, out, off & 31);
+  }
+};
+
+
+/**
+* Column from file, decoded straight from mapped pages
+*/
+class MappedCompressed : public CompressedLayout {
+  MappedFile _file;
+
+public:
+  explicit MappedCompressed(const std::string& path) :
+    _file(path)
+  {
+    attach(_file.data(), _file.size(), path);
+  }
+};
+
+
+/**
+* Column from shared memory segment, written once by
+* Compressed::write_layout in another process.
+*/
+class SharedCompressed : public CompressedLayout {
+  SharedMemory _segment;
+
+public:
+  explicit SharedCompressed(const std::string& name) :
+    _segment(name)
+  {
+    attach(_segment.data(), _segment.size(), name);
+  }
+};
+
+
+/**
+* Read only random access range over Compressed.
+* Values are decoded lazily by blocks, last cache_blocks blocks 
+* are kept (LRU), so memory is bounded and local access is cheap.
+* Iterators return values, not references. Not thread safe.
+*/
+class CompressedView {
+  struct Block {
+    uint64_t id;
+    uint64_t used;
+    std::vector<uint32_t> values;
+  };
+
+  const uint32_t* _data;
+  uint64_t _digits;
+  uint32_t _block;
+  std::vector<uint64_t> _offsets;
+
+  mutable std::vector<Block> _cache;
+  mutable size_t _last;
+  mutable uint64_t _tick;
+  mutable uint64_t _misses;
+
+  const Block& fetch(uint64_t b) const {
+    // sequential access hits the same block over and over
+    if (_cache[_last].id == b) {
+      return _cache[_last];
+    }
+
+    size_t victim = 0;
+    for (size_t j = 0; j < _cache.size(); ++j) {
+      if (_cache[j].id == b) {
+        _cache[j].used = ++_tick;
+        _last = j;
+        return _cache[j];
+      }
+
+      if (_cache[j].used < _cache[victim].used) {
+        victim = j;
+      }
+    }
+
+    auto& e = _cache[victim];
+    const uint64_t first = b * _block;
+    const uint64_t off = _offsets[b];
+
+    e.values.resize(std::min<uint64_t>(_block, _digits - first));
+    Compressed::decode_optimized(_data + (off >> 5), e.values.size(), e.values.data(), off & 31);
+
+    e.id = b;
+    e.used = ++_tick;
+    _last = victim;
+    ++_misses;
+
+    return e;
+  }
+
+public:
+  class const_iterator {
+    const CompressedView* _view;
+    uint64_t _i;
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = uint32_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = uint32_t;
+
+    const_iterator() : _view(nullptr), _i(0) {}
+    const_iterator(const CompressedView* view, uint64_t i) : _view(view), _i(i) {}
+
+    uint32_t operator*() const { return (*_view)[_i]; }
+    uint32_t operator[](difference_type d) const { return (*_view)[_i + d]; }
+
+    const_iterator& operator++() { ++_i; return *this; }
+    const_iterator& operator--() { --_i; return *this; }
+    const_iterator operator++(int) { auto r = *this; ++_i; return r; }
+    const_iterator operator--(int) { auto r = *this; --_i; return r; }
+
+    const_iterator& operator+=(difference_type d) { _i += d; return *this; }
+    const_iterator& operator-=(difference_type d) { _i -= d; return *this; }
+    const_iterator operator+(difference_type d) const { return { _view, _i + d }; }
+    const_iterator operator-(difference_type d) const { return { _view, _i - d }; }
+    friend const_iterator operator+(difference_type d, const const_iterator& it) { return it + d; }
+
+    difference_type operator-(const const_iterator& r) const { 
+      return (difference_type)_i - (difference_type)r._i; 
+    }
+
+    bool operator==(const const_iterator& r) const { return _i == r._i; }
+    bool operator!=(const const_iterator& r) const { return _i != r._i; }
+    bool operator<(const const_iterator& r) const { return _i < r._i; }
+    bool operator>(const const_iterator& r) const { return _i > r._i; }
+    bool operator<=(const const_iterator& r) const { return _i <= r._i; }
+    bool operator>=(const const_iterator& r) const { return _i >= r._i; }
+  };
+
+  using iterator = const_iterator;
+  using value_type = uint32_t;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+
+  /**
+  * c must outlive the view
+  */
+  explicit CompressedView(
+    const Compressed& c, 
+    uint32_t block = 1024, 
+    size_t cache_blocks = 8) :
+    _data(c.data().data()),
+    _digits(c.digits()),
+    _block(block),
+    _offsets(c.block_offsets(block)),
+    _cache(std::max<size_t>(cache_blocks, 1), Block{ std::numeric_limits<uint64_t>::max(), 0, {} }),
+    _last(0),
+    _tick(0),
+    _misses(0)
+  {}
+
+  uint32_t operator[](size_t i) const {
+    return fetch(i / _block).values[i % _block];
+  }
+
+  size_t size() const {
+    return _digits;
+  }
+
+  bool empty() const {
+    return _digits == 0;
+  }
+
+  const_iterator begin() const {
+    return { this, 0 };
+  }
+
+  const_iterator end() const {
+    return { this, _digits };
+  }
+
+  // decoded blocks, for cache tuning
+  uint64_t misses() const {
+    return _misses;
+  }
+};
+
+
+/**
+* Many short series in one buffer.
+* Series streams start at word boundary and are listed in offsets
+* table, so any subset can be decoded without touching the rest.
+* Decoding never leaves SIMD loop: output of every series may
+* overrun into the next one, which is decoded right after.
+*/
+class CompressedBatch {
+  std::vector<uint32_t> _data;
+  std::vector<uint64_t> _offsets;   // word offset of series, size + 1 entries
+  std::vector<uint32_t> _counts;
+
+public:
+  /**
+  * values - all series one after another, lengths - values per series
+  */
+  CompressedBatch(const uint32_t* values, const uint32_t* lengths, size_t series) :
+    _data{},
+    _offsets(series + 1),
+    _counts(lengths, lengths + series)
+  {
+    // one pass: room for the worst case of the next series, buffer
+    // grows geometrically and is cut to the real size at the end.
+    // Spare word of every series is overwritten by the next one.
+    const uint32_t* v = values;
+    uint64_t offset = 0;
+    _offsets[0] = 0;
+
+    for (size_t i = 0; i < series; ++i) {
+      auto need = offset + Compressed::max_encoded_words(lengths[i]);
+      if (need > _data.size()) {
+        _data.resize(std::max<size_t>(need, _data.size() * 2));
+      }
+
+      auto bits = Compressed::encode(v, lengths[i], _data.data() + offset);
+      offset += (bits + 31) / 32;
+      _offsets[i + 1] = offset;
+      v += lengths[i];
+    }
+
+    // spare word of the last encode store + padded decode over-read
+    _data.resize(offset + 1 + DECODE_INPUT_SLACK);
+    _data.shrink_to_fit();
+  }
+
+  size_t size() const {
+    return _counts.size();
+  }
+
+  uint32_t values(size_t i) const {
+    return _counts[i];
+  }
+
+  uint64_t bits() const {
+    return _offsets.back() * 32;
+  }
+
+  /**
+  * out must hold values(i) + DECODE_SLACK
+  */
+  void decode(size_t i, uint32_t* out) const {
+    Compressed::decode_padded(_data.data() + _offsets[i], _counts[i], out);
+  }
+
+  /**
+  * Decode chosen series one after another into out, which must hold
+  * sum of their values + DECODE_SLACK. Returns values written.
+  */
+  size_t decode(const size_t* ids, size_t k, uint32_t* out) const {
+    uint32_t* o = out;
+
+    for (size_t j = 0; j < k; ++j) {
+      decode(ids[j], o);
+      o += _counts[ids[j]];
+    }
+
+    return o - out;
+  }
+
+  size_t decoded_size(const size_t* ids, size_t k) const {
+    size_t res = 0;
+    for (size_t j = 0; j < k; ++j) {
+      res += _counts[ids[j]];
+    }
+    return res;
+  }
+};
+
+
+/**
+* Column with point updates.
+* Values live in per-block Compressed streams, updates go to sorted
+* override buffer (O(log n)) and are folded into blocks by merge,
+* which re-encodes only blocks that have updates.
+* Reads consult overrides, so at most one block is decoded per get().
+* set/get/decompress are thread safe, merge runs one at a time.
+*/
+class MutableColumn {
+  uint32_t _block;
+  uint64_t _digits;
+  std::vector<Compressed> _blocks;
+
+  std::map<uint64_t, uint32_t> _overrides;   // newest writes
+  std::map<uint64_t, uint32_t> _merging;     // being folded into blocks
+
+  mutable std::shared_mutex _mutex;
+  std::thread _merger;
+
+  void check_index(uint64_t i) const {
+    if (i >= _digits) {
+      throw std::out_of_range("Index " + std::to_string(i) + 
+        " out of column of " + std::to_string(_digits));
+    }
+  }
+
+  void merge_pending() {
+    {
+      std::unique_lock<std::shared_mutex> lock(_mutex);
+      _merging.swap(_overrides);
+    }
+
+    // only merge thread replaces blocks, so they can be read without lock
+    std::vector<std::pair<size_t, Compressed>> rebuilt;
+    std::vector<uint32_t> values;
+
+    for (auto it = _merging.begin(); it != _merging.end();) {
+      const size_t b = it->first / _block;
+      const auto& blk = _blocks[b];
+
+      values.resize(blk.digits());
+      Compressed::decode_optimized(blk.data().data(), blk.digits(), values.data());
+
+      for (; it != _merging.end() && it->first / _block == b; ++it) {
+        values[it->first % _block] = it->second;
+      }
+
+      rebuilt.emplace_back(b, Compressed(values));
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    for (auto& r : rebuilt) {
+      _blocks[r.first] = std::move(r.second);
+    }
+    _merging.clear();
+  }
+
+public:
+  explicit MutableColumn(const std::vector<uint32_t>& v, uint32_t block = 4096) :
+    _block(block),
+    _digits(v.size()),
+    _blocks{}
+  {
+    _blocks.reserve((v.size() + block - 1) / block);
+
+    for (size_t first = 0; first < v.size(); first += block) {
+      _blocks.emplace_back(std::vector<uint32_t>(
+        v.begin() + first, 
+        v.begin() + std::min<size_t>(first + block, v.size())));
+    }
+  }
+
+  MutableColumn(const MutableColumn&) = delete;
+  MutableColumn& operator=(const MutableColumn&) = delete;
+
+  ~MutableColumn() {
+    wait();
+  }
+
+  uint64_t size() const {
+    return _digits;
+  }
+
+  // out_of_range for i >= size(), column doesn't grow
+  void set(uint64_t i, uint32_t v) {
+    check_index(i);
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    _overrides[i] = v;
+  }
+
+  uint32_t get(uint64_t i) const {
+    check_index(i);
+
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+
+    auto it = _overrides.find(i);
+    if (it != _overrides.end()) {
+      return it->second;
+    }
+
+    it = _merging.find(i);
+    if (it != _merging.end()) {
+      return it->second;
+    }
+
+    const auto& blk = _blocks[i / _block];
+    std::vector<uint32_t> values(blk.digits());
+    Compressed::decode_optimized(blk.data().data(), blk.digits(), values.data());
+
+    return values[i % _block];
+  }
+
+  /**
+  * out must hold size() values
+  */
+  void decompress(uint32_t* out) const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+
+    uint32_t* o = out;
+    for (const auto& blk : _blocks) {
+      Compressed::decode_optimized(blk.data().data(), blk.digits(), o);
+      o += blk.digits();
+    }
+
+    // older pending writes first, newer ones win
+    for (const auto& p : _merging) {
+      out[p.first] = p.second;
+    }
+    for (const auto& p : _overrides) {
+      out[p.first] = p.second;
+    }
+  }
+
+  std::vector<uint32_t> decompress() const {
+    std::vector<uint32_t> res(_digits);
+    decompress(res.data());
+    return res;
+  }
+
+  // updates not folded into blocks yet
+  size_t pending() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _overrides.size() + _merging.size();
+  }
+
+  void merge() {
+    wait();
+    merge_pending();
+  }
+
+  void merge_async() {
+    wait();
+    _merger = std::thread([this] { merge_pending(); });
+  }
+
+  void wait() {
+    if (_merger.joinable()) {
+      _merger.join();
+    }
+  }
+
+  /**
+  * Single stream of merged blocks, pending updates are not included
+  */
+  Compressed compact() const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return Compressed::concat(_blocks.data(), _blocks.size());
+  }
+};
+
+
+namespace {
+  /**
+  * Delta-of-delta buckets, prefix codes are 0, 10, 110, 1110, 1111
+  * indexed by number of leading ones.
+  * dod is stored with bias, so payload is unsigned.
+  */
+  constexpr uint8_t DOD_CODE_LENGTH[5] = { 1, 2, 3, 4, 4 };
+  constexpr uint8_t DOD_PAYLOAD_LENGTH[5] = { 0, 7, 9, 12, 64 };
+  constexpr uint64_t DOD_CODE[5] = { 0x0, 0x2, 0x6, 0xe, 0xf };
+  constexpr int64_t DOD_BIAS[5] = { 0, 63, 255, 2047, 0 };
+
+  uint8_t dodBucket(int64_t dod) {
+    if (dod == 0) {
+      return 0;
+    }
+    if (dod >= -63 && dod <= 64) {
+      return 1;
+    }
+    if (dod >= -255 && dod <= 256) {
+      return 2;
+    }
+    if (dod >= -2047 && dod <= 2048) {
+      return 3;
+    }
+    return 4;
+  }
+
+  // v[i] = v[i - k], zeros shifted in
+  __m512i shiftLanes(__m512i v, int k) {
+    const auto zero = _mm512_setzero_si512();
+    switch (k) {
+    case 1: return _mm512_alignr_epi64(v, zero, 7);
+    case 2: return _mm512_alignr_epi64(v, zero, 6);
+    default: return _mm512_alignr_epi64(v, zero, 4);
+    }
+  }
+
+  __m512i prefixSum(__m512i v) {
+    v = _mm512_add_epi64(v, shiftLanes(v, 1));
+    v = _mm512_add_epi64(v, shiftLanes(v, 2));
+    v = _mm512_add_epi64(v, shiftLanes(v, 4));
+    return v;
+  }
+
+  /**
+  * Bit writer over Compressed::flush, field up to 32 bits
+  */
+  void putBits(uint32_t*& o, uint64_t& buf, uint8_t& bbits, uint64_t v, uint8_t len) {
+    buf |= v << (64 - len - bbits);
+    bbits += len;
+    Compressed::flush(o, buf, bbits);
+  }
+
+  void putBits64(uint32_t*& o, uint64_t& buf, uint8_t& bbits, uint64_t v) {
+    putBits(o, buf, bbits, v >> 32, 32);
+    putBits(o, buf, bbits, v & 0xffffffffull, 32);
+  }
+
+  /**
+  * Stream reader, keeps at least 32 bits in buffer.
+  * Streams must have 2 spare words, so refill never reads past them.
+  */
+  struct BitReader {
+    const uint32_t* it;
+    uint64_t buf;
+    uint8_t bbits;
+
+    void refill() {
+      if (bbits < 32) {
+        buf |= ((uint64_t)*it) << (32 - bbits);
+        bbits += 32;
+        ++it;
+      }
+    }
+
+    // 0 < len <= 32
+    uint64_t get(uint8_t len) {
+      refill();
+      uint64_t v = buf >> (64 - len);
+      buf <<= len;
+      bbits -= len;
+      return v;
+    }
+
+    uint64_t get64() {
+      uint64_t hi = get(32);
+      return (hi << 32) | get(32);
+    }
+  };
+}
+
+
+/**
+* Gorilla style codec for monotone 64-bit timestamps.
+* First value raw, then delta-of-delta in prefix coded buckets,
+* regular series take 1 bit per value.
+* Uses Compressed::flush, so the word layout is the same.
+*/
+class CompressedTimestamps {
+  uint64_t _bits;
+  uint64_t _count;
+  std::vector<uint32_t> _data;
+
+  static int64_t readDod(BitReader& r) {
+    r.refill();
+    auto ones = std::min<uint64_t>(__lzcnt64(~r.buf), 4);
+
+    r.buf <<= DOD_CODE_LENGTH[ones];
+    r.bbits -= DOD_CODE_LENGTH[ones];
+
+    if (ones == 4) {
+      return (int64_t)r.get64();
+    }
+
+    return ones == 0 ? 0 : (int64_t)r.get(DOD_PAYLOAD_LENGTH[ones]) - DOD_BIAS[ones];
+  }
+
+public:
+  static size_t encoded_words(const uint64_t* v, size_t n) {
+    uint64_t bits = n > 0 ? 64 : 0;
+    uint64_t prev_delta = 0;
+
+    for (size_t i = 1; i < n; ++i) {
+      uint64_t delta = v[i] - v[i - 1];
+      auto b = dodBucket((int64_t)(delta - prev_delta));
+      bits += DOD_CODE_LENGTH[b] + DOD_PAYLOAD_LENGTH[b];
+      prev_delta = delta;
+    }
+
+    return (bits + 31) / 32 + 1;
+  }
+
+  explicit CompressedTimestamps(const std::vector<uint64_t>& v) :
+    _bits(0),
+    _count(v.size()),
+    _data(encoded_words(v.data(), v.size()) + 2)
+  {
+    uint64_t buf = 0;
+    uint8_t bbits = 0;
+    uint32_t* o = _data.data();
+
+    if (!v.empty()) {
+      putBits64(o, buf, bbits, v[0]);
+    }
+
+    uint64_t prev_delta = 0;
+
+    for (size_t i = 1; i < v.size(); ++i) {
+      uint64_t delta = v[i] - v[i - 1];
+      int64_t dod = (int64_t)(delta - prev_delta);
+      prev_delta = delta;
+
+      auto b = dodBucket(dod);
+
+      if (b == 4) {
+        putBits(o, buf, bbits, DOD_CODE[4], DOD_CODE_LENGTH[4]);
+        putBits64(o, buf, bbits, (uint64_t)dod);
+      }
+      else {
+        auto len = DOD_CODE_LENGTH[b] + DOD_PAYLOAD_LENGTH[b];
+        putBits(o, buf, bbits, 
+          (DOD_CODE[b] << DOD_PAYLOAD_LENGTH[b]) | (uint64_t)(dod + DOD_BIAS[b]), len);
+      }
+    }
+
+    _bits = (o - _data.data()) * 32ull + bbits;
+  }
+
+  std::vector<uint64_t> decompress() const {
+    std::vector<uint64_t> res(_count);
+    if (_count == 0) {
+      return res;
+    }
+
+    BitReader r{ _data.data(), 0, 0 };
+
+    res[0] = r.get64();
+    uint64_t delta = 0;
+
+    for (size_t i = 1; i < _count; ++i) {
+      delta += readDod(r);
+      res[i] = res[i - 1] + delta;
+    }
+
+    return res;
+  }
+
+  /**
+  * Bit parsing stays scalar (with 8 zero dods per byte fast path),
+  * reconstruction is two 8-lane prefix sums per 8 values.
+  * out must hold size() values.
+  */
+  void decompress_optimized(uint64_t* out) const {
+    if (_count == 0) {
+      return;
+    }
+
+    BitReader r{ _data.data(), 0, 0 };
+
+    out[0] = r.get64();
+
+    auto delta = _mm512_setzero_si512();
+    auto value = _mm512_set1_epi64(out[0]);
+    const auto last = _mm512_set1_epi64(7);
+
+    alignas(64) int64_t dods[8];
+
+    size_t i = 1;
+    for (; i + 8 <= _count; i += 8) {
+      r.refill();
+
+      if ((r.buf >> 56) == 0) {
+        // regular interval: 8 values in one byte, delta is unchanged
+        r.buf <<= 8;
+        r.bbits -= 8;
+
+        auto v = _mm512_add_epi64(prefixSum(delta), value);
+        _mm512_storeu_si512(out + i, v);
+        value = _mm512_permutexvar_epi64(last, v);
+        continue;
+      }
+
+      for (int k = 0; k < 8; ++k) {
+        dods[k] = readDod(r);
+      }
+
+      auto d = _mm512_add_epi64(prefixSum(_mm512_load_si512(dods)), delta);
+      auto v = _mm512_add_epi64(prefixSum(d), value);
+
+      _mm512_storeu_si512(out + i, v);
+
+      delta = _mm512_permutexvar_epi64(last, d);
+      value = _mm512_permutexvar_epi64(last, v);
+    }
+
+    uint64_t dl = i > 1 ? out[i - 1] - out[i - 2] : 0;
+    for (; i < _count; ++i) {
+      dl += readDod(r);
+      out[i] = out[i - 1] + dl;
+    }
+  }
+
+  std::vector<uint64_t> decompress_optimized() const {
+    std::vector<uint64_t> res(_count);
+    decompress_optimized(res.data());
+    return res;
+  }
+
+  uint64_t bits() const {
+    return _bits;
+  }
+
+  uint64_t size() const {
+    return _count;
+  }
+};
+
+
+/**
+* Gorilla style XOR codec for float and double columns.
+* Every value is XORed with the previous one, XOR is stored as:
+*   0                                     - same value
+*   10 + meaningful bits                  - fits previous window
+*   11 + 5 bit lzcnt + 6 bit length + bits - new window
+* Decoding parses XORs and restores values with SIMD prefix XOR,
+* 8 doubles or 16 floats at a time.
+*/
+template <typename T>
+class CompressedFloats {
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+
+  using U = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+
+  static constexpr uint8_t W = sizeof(T) * 8;
+  static constexpr size_t LANES = 64 / sizeof(T);
+
+  uint64_t _bits;
+  uint64_t _count;
+  std::vector<uint32_t> _data;
+
+  static U toBits(T v) {
+    U u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+  }
+
+  static uint8_t lz(U x) {
+    if constexpr (sizeof(U) == 8) {
+      return (uint8_t)__lzcnt64(x);
+    }
+    else {
+      return (uint8_t)__lzcnt(x);
+    }
+  }
+
+  static uint8_t tz(U x) {
+    if constexpr (sizeof(U) == 8) {
+      return (uint8_t)_tzcnt_u64(x);
+    }
+    else {
+      return (uint8_t)_tzcnt_u32(x);
+    }
+  }
+
+  // put(value, len) for every field, len may be up to 64
+  template <typename Put>
+  static void encode(const T* v, size_t n, Put put) {
+    if (n == 0) {
+      return;
+    }
+
+    U prev = toBits(v[0]);
+    put(prev, W);
+
+    // no window yet
+    uint8_t plead = W;
+    uint8_t ptrail = 0;
+
+    for (size_t i = 1; i < n; ++i) {
+      U cur = toBits(v[i]);
+      U x = cur ^ prev;
+      prev = cur;
+
+      if (x == 0) {
+        put(0, 1);
+        continue;
+      }
+
+      uint8_t lead = std::min<uint8_t>(lz(x), 31);
+      uint8_t trail = tz(x);
+
+      if (plead < W && lead >= plead && trail >= ptrail) {
+        put(0x2, 2);
+        put(x >> ptrail, W - plead - ptrail);
+      }
+      else {
+        uint8_t len = W - lead - trail;
+        put((0x3 << 11) | ((uint64_t)lead << 6) | (len & 63), 13);
+        put(x >> trail, len);
+
+        plead = lead;
+        ptrail = trail;
+      }
+    }
+  }
+
+  // one XOR, prev window is updated
+  static U readXor(BitReader& r, uint8_t& plead, uint8_t& ptrail) {
+    if (r.get(1) == 0) {
+      return 0;
+    }
+
+    if (r.get(1) == 0) {
+      return (U)readBits(r, W - plead - ptrail) << ptrail;
+    }
+
+    plead = (uint8_t)r.get(5);
+    uint8_t len = (uint8_t)r.get(6);
+    len = len == 0 ? 64 : len;
+    ptrail = W - plead - len;
+
+    return (U)readBits(r, len) << ptrail;
+  }
+
+  static uint64_t readBits(BitReader& r, uint8_t len) {
+    if (len > 32) {
+      uint64_t hi = r.get(len - 32);
+      return (hi << 32) | r.get(32);
+    }
+
+    return r.get(len);
+  }
+
+  static __m512i prefixXor(__m512i v) {
+    const auto zero = _mm512_setzero_si512();
+
+    if constexpr (sizeof(U) == 8) {
+      v = _mm512_xor_si512(v, _mm512_alignr_epi64(v, zero, 7));
+      v = _mm512_xor_si512(v, _mm512_alignr_epi64(v, zero, 6));
+      v = _mm512_xor_si512(v, _mm512_alignr_epi64(v, zero, 4));
+    }
+    else {
+      v = _mm512_xor_si512(v, _mm512_alignr_epi32(v, zero, 15));
+      v = _mm512_xor_si512(v, _mm512_alignr_epi32(v, zero, 14));
+      v = _mm512_xor_si512(v, _mm512_alignr_epi32(v, zero, 12));
+      v = _mm512_xor_si512(v, _mm512_alignr_epi32(v, zero, 8));
+    }
+
+    return v;
+  }
+
+  static __m512i broadcastLast(__m512i v) {
+    if constexpr (sizeof(U) == 8) {
+      return _mm512_permutexvar_epi64(_mm512_set1_epi64(7), v);
+    }
+    else {
+      return _mm512_permutexvar_epi32(_mm512_set1_epi32(15), v);
+    }
+  }
+
+public:
+  explicit CompressedFloats(const std::vector<T>& v) :
+    _bits(0),
+    _count(v.size()),
+    _data{}
+  {
+    uint64_t bits = 0;
+    encode(v.data(), v.size(), [&](uint64_t, uint8_t len) { bits += len; });
+
+    // spare word of flush + 2 for reader refill
+    _data.resize((bits + 31) / 32 + 3);
+
+    uint64_t buf = 0;
+    uint8_t bbits = 0;
+    uint32_t* o = _data.data();
+
+    encode(v.data(), v.size(), [&](uint64_t x, uint8_t len) {
+      if (len > 32) {
+        putBits(o, buf, bbits, x >> 32, len - 32);
+        len = 32;
+        x &= 0xffffffffull;
+      }
+      putBits(o, buf, bbits, x, len);
+    });
+
+    _bits = (o - _data.data()) * 32ull + bbits;
+  }
+
+  std::vector<T> decompress() const {
+    std::vector<T> res(_count);
+    if (_count == 0) {
+      return res;
+    }
+
+    BitReader r{ _data.data(), 0, 0 };
+
+    U prev = (U)readBits(r, W);
+    memcpy(&res[0], &prev, sizeof(prev));
+
+    uint8_t plead = W;
+    uint8_t ptrail = 0;
+
+    for (size_t i = 1; i < _count; ++i) {
+      prev ^= readXor(r, plead, ptrail);
+      memcpy(&res[i], &prev, sizeof(prev));
+    }
+
+    return res;
+  }
+
+  /**
+  * out must hold size() values
+  */
+  void decompress_optimized(T* out) const {
+    if (_count == 0) {
+      return;
+    }
+
+    BitReader r{ _data.data(), 0, 0 };
+
+    U first = (U)readBits(r, W);
+    memcpy(out, &first, sizeof(first));
+
+    uint8_t plead = W;
+    uint8_t ptrail = 0;
+
+    auto prev = sizeof(U) == 8 
+      ? _mm512_set1_epi64((int64_t)first) 
+      : _mm512_set1_epi32((int32_t)first);
+
+    alignas(64) U xors[LANES];
+
+    size_t i = 1;
+    for (; i + LANES <= _count; i += LANES) {
+      r.refill();
+
+      if ((r.buf >> (64 - LANES)) == 0) {
+        // LANES repeats of the same value
+        r.buf <<= LANES;
+        r.bbits -= LANES;
+        _mm512_storeu_si512(out + i, prev);
+        continue;
+      }
+
+      for (size_t k = 0; k < LANES; ++k) {
+        xors[k] = readXor(r, plead, ptrail);
+      }
+
+      auto v = _mm512_xor_si512(prefixXor(_mm512_load_si512(xors)), prev);
+      _mm512_storeu_si512(out + i, v);
+      prev = broadcastLast(v);
+    }
+
+    U p;
+    memcpy(&p, out + i - 1, sizeof(p));
+
+    for (; i < _count; ++i) {
+      p ^= readXor(r, plead, ptrail);
+      memcpy(out + i, &p, sizeof(p));
+    }
+  }
+
+  std::vector<T> decompress_optimized() const {
+    std::vector<T> res(_count);
+    decompress_optimized(res.data());
+    return res;
+  }
+
+  uint64_t bits() const {
+    return _bits;
+  }
+
+  uint64_t size() const {
+    return _count;
+  }
+};
+
+using CompressedDoubles = CompressedFloats<double>;
+
+
+/**
+* Sorted unique IDs (posting list), delta coded in blocks of BLOCK.
+* Skip table keeps first and last ID of every block, so intersection
+* decodes only blocks whose range overlaps the other list.
+*/
+class CompressedPostings {
+public:
+  static constexpr uint32_t BLOCK = 128;
+
+private:
+  uint64_t _size;
+  std::vector<uint32_t> _first;
+  std::vector<uint32_t> _last;
+  CompressedBatch _gaps;
+
+  // gaps inside blocks, first gap of a block is 0
+  static CompressedBatch encodeGaps(const std::vector<uint32_t>& v) {
+    std::vector<uint32_t> gaps(v.size());
+    std::vector<uint32_t> lengths;
+
+    for (size_t i = 0; i < v.size(); ++i) {
+      gaps[i] = i % BLOCK == 0 ? 0 : v[i] - v[i - 1];
+      if (i % BLOCK == 0) {
+        lengths.push_back(std::min<size_t>(BLOCK, v.size() - i));
+      }
+    }
+
+    return CompressedBatch(gaps.data(), lengths.data(), lengths.size());
+  }
+
+  static __m512i prefixSum32(__m512i v) {
+    const auto zero = _mm512_setzero_si512();
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 15));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 14));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 12));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 8));
+    return v;
+  }
+
+public:
+  /**
+  * v must be sorted and unique
+  */
+  explicit CompressedPostings(const std::vector<uint32_t>& v) :
+    _size(v.size()),
+    _first{},
+    _last{},
+    _gaps(encodeGaps(v))
+  {
+    for (size_t i = 0; i < v.size(); i += BLOCK) {
+      _first.push_back(v[i]);
+      _last.push_back(v[std::min<size_t>(i + BLOCK, v.size()) - 1]);
+    }
+  }
+
+  uint64_t size() const {
+    return _size;
+  }
+
+  size_t blocks() const {
+    return _first.size();
+  }
+
+  uint32_t first(size_t b) const {
+    return _first[b];
+  }
+
+  uint32_t last(size_t b) const {
+    return _last[b];
+  }
+
+  uint64_t bits() const {
+    return _gaps.bits() + _first.size() * 64;
+  }
+
+  /**
+  * out must hold BLOCK + DECODE_SLACK values, returns values count
+  */
+  size_t decode_block(size_t b, uint32_t* out) const {
+    const size_t n = _gaps.values(b);
+    _gaps.decode(b, out);
+
+    // SIMD prefix sum of gaps, slack covers the last partial vector
+    auto carry = _mm512_set1_epi32((int)_first[b]);
+    const auto last = _mm512_set1_epi32(15);
+
+    for (size_t i = 0; i < n; i += 16) {
+      auto v = _mm512_add_epi32(prefixSum32(_mm512_loadu_si512(out + i)), carry);
+      _mm512_storeu_si512(out + i, v);
+      carry = _mm512_permutexvar_epi32(last, v);
+    }
+
+    return n;
+  }
+
+  std::vector<uint32_t> decompress() const {
+    std::vector<uint32_t> res(_size + DECODE_SLACK);
+    for (size_t b = 0; b < blocks(); ++b) {
+      decode_block(b, res.data() + b * BLOCK);
+    }
+    res.resize(_size);
+    return res;
+  }
+
+  /**
+  * First block from `from` with last() >= x, galloping over skip table
+  */
+  size_t find_block(size_t from, uint32_t x) const {
+    size_t step = 1;
+    size_t lo = from;
+    size_t hi = from;
+
+    while (hi < _last.size() && _last[hi] < x) {
+      lo = hi + 1;
+      hi += step;
+      step <<= 1;
+    }
+
+    hi = std::min(hi, _last.size());
+    return std::lower_bound(_last.begin() + lo, _last.begin() + hi, x) - _last.begin();
+  }
+};
+
+
+namespace {
+  /**
+  * Intersect sorted a with sorted b, b is readable for 16 values past nb.
+  * Every a is compared with 16 b values at once.
+  */
+  size_t intersectBlocks(
+    const uint32_t* a, 
+    size_t na, 
+    const uint32_t* b, 
+    size_t nb, 
+    uint32_t* out) {
+    size_t j = 0;
+    size_t k = 0;
+
+    for (size_t i = 0; i < na && j < nb; ++i) {
+      const uint32_t x = a[i];
+
+      while (j + 16 <= nb && b[j + 15] < x) {
+        j += 16;
+      }
+
+      const __mmask16 valid = nb - j >= 16 ? 0xffff : (__mmask16)((1u << (nb - j)) - 1);
+      auto m = _mm512_mask_cmpeq_epi32_mask(valid, 
+        _mm512_set1_epi32((int)x), _mm512_loadu_si512(b + j));
+
+      out[k] = x;
+      k += m != 0;
+    }
+
+    return k;
+  }
+
+  /**
+  * Keep candidates present in list, cursor is the first block
+  * that can still match. Candidates are sorted, out may alias them.
+  */
+  size_t intersectWith(
+    const uint32_t* cand,
+    size_t n,
+    const CompressedPostings& list,
+    size_t& cursor,
+    uint32_t* block,
+    size_t& decoded,
+    uint32_t* out) {
+    size_t k = 0;
+    size_t i = 0;
+
+    while (i < n) {
+      cursor = list.find_block(cursor, cand[i]);
+      if (cursor == list.blocks()) {
+        break;
+      }
+
+      // candidates before the block have no match
+      if (list.first(cursor) > cand[i]) {
+        i = std::lower_bound(cand + i, cand + n, list.first(cursor)) - cand;
+        continue;
+      }
+
+      const size_t e = std::upper_bound(cand + i, cand + n, list.last(cursor)) - cand;
+
+      if (decoded != cursor) {
+        auto nb = list.decode_block(cursor, block);
+        std::fill(block + nb, block + nb + DECODE_SLACK, std::numeric_limits<uint32_t>::max());
+        decoded = cursor;
+      }
+
+      const size_t nb = cursor + 1 < list.blocks()
+        ? CompressedPostings::BLOCK
+        : list.size() - cursor * CompressedPostings::BLOCK;
+
+      k += intersectBlocks(cand + i, e - i, block, nb, out + k);
+      i = e;
+    }
+
+    return k;
+  }
+}
+
+/**
+* k-way intersection, smallest list drives: its blocks are decoded one
+* by one and filtered through every other list, so cost depends on
+* the smallest list and on blocks it overlaps.
+*/
+std::vector<uint32_t> intersect(std::vector<const CompressedPostings*> lists) {
+  std::vector<uint32_t> res;
+  if (lists.empty()) {
+    return res;
+  }
+
+  std::sort(lists.begin(), lists.end(), 
+    [](const auto* l, const auto* r) { return l->size() < r->size(); });
+
+  const auto& driver = *lists[0];
+  const size_t k = lists.size();
+
+  std::vector<size_t> cursors(k, 0);
+  std::vector<size_t> decoded(k, std::numeric_limits<size_t>::max());
+  std::vector<std::vector<uint32_t>> blocks(k, 
+    std::vector<uint32_t>(CompressedPostings::BLOCK + DECODE_SLACK));
+
+  std::vector<uint32_t> cand(CompressedPostings::BLOCK + DECODE_SLACK);
+
+  for (size_t b = 0; b < driver.blocks(); ++b) {
+    // skip block without decode if some list has nothing in its range
+    bool overlaps = true;
+    for (size_t j = 1; j < k && overlaps; ++j) {
+      cursors[j] = lists[j]->find_block(cursors[j], driver.first(b));
+      overlaps = cursors[j] < lists[j]->blocks() && 
+        lists[j]->first(cursors[j]) <= driver.last(b);
+
+      if (cursors[j] == lists[j]->blocks()) {
+        return res;
+      }
+    }
+
+    if (!overlaps) {
+      continue;
+    }
+
+    size_t n = driver.decode_block(b, cand.data());
+
+    for (size_t j = 1; j < k && n > 0; ++j) {
+      n = intersectWith(cand.data(), n, *lists[j], cursors[j], 
+        blocks[j].data(), decoded[j], cand.data());
+    }
+
+    res.insert(res.end(), cand.begin(), cand.begin() + n);
+  }
+
+  return res;
+}
+
+std::vector<uint32_t> intersect(const CompressedPostings& a, const CompressedPostings& b) {
+  return intersect(std::vector<const CompressedPostings*>{ &a, &b });
+}
+
+
+/**
+* Every codec on every column: bits per value, encode and decode time.
+* Codecs that need a shape are skipped on other columns (postings need
+* sorted unique values). Returns false if any round trip differs.
+*/
+bool runCodecMatrix(const std::vector<std::pair<std::string, const std::vector<uint32_t>*>>& columns) {
+  using Clock = std::chrono::high_resolution_clock;
+
+  auto us = [](Clock::time_point from, Clock::time_point to) {
+    return (long long)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+  };
+
+  struct Result {
+    uint64_t bits;
+    long long encode;
+    long long decode;
+    bool same;
+  };
+
+  using Codec = std::function<Result(const std::vector<uint32_t>&)>;
+
+  const std::vector<std::pair<std::string, Codec>> codecs{
+    { "Compressed", [&](const std::vector<uint32_t>& v) {
+      auto t1 = Clock::now();
+      Compressed c(v);
+      auto t2 = Clock::now();
+      auto d = c.decompress_optimized();
+      auto t3 = Clock::now();
+      return Result{ c.bits(), us(t1, t2), us(t2, t3), d == v };
+    } },
+    { "Snappy", [&](const std::vector<uint32_t>& v) {
+      std::string c;
+      std::string d;
+      auto t1 = Clock::now();
+      snappy::Compress(reinterpret_cast<const char*>(v.data()), v.size() * 4, &c);
+      auto t2 = Clock::now();
+      snappy::Uncompress(c.data(), c.size(), &d);
+      auto t3 = Clock::now();
+      return Result{ c.size() * 8, us(t1, t2), us(t2, t3), 
+        d.size() == v.size() * 4 && memcmp(d.data(), v.data(), d.size()) == 0 };
+    } },
+    { "Delta of delta", [&](const std::vector<uint32_t>& v) {
+      std::vector<uint64_t> wide(v.begin(), v.end());
+      auto t1 = Clock::now();
+      CompressedTimestamps c(wide);
+      auto t2 = Clock::now();
+      auto d = c.decompress_optimized();
+      auto t3 = Clock::now();
+      return Result{ c.bits(), us(t1, t2), us(t2, t3), d == wide };
+    } },
+    { "XOR", [&](const std::vector<uint32_t>& v) {
+      // bit patterns as floats, compared as bits
+      std::vector<float> f(v.size());
+      memcpy(f.data(), v.data(), v.size() * 4);
+      auto t1 = Clock::now();
+      CompressedFloats<float> c(f);
+      auto t2 = Clock::now();
+      auto d = c.decompress_optimized();
+      auto t3 = Clock::now();
+      return Result{ c.bits(), us(t1, t2), us(t2, t3), 
+        d.size() == v.size() && memcmp(d.data(), v.data(), v.size() * 4) == 0 };
+    } },
+    { "Postings", [&](const std::vector<uint32_t>& v) {
+      auto t1 = Clock::now();
+      CompressedPostings c(v);
+      auto t2 = Clock::now();
+      auto d = c.decompress();
+      auto t3 = Clock::now();
+      return Result{ c.bits(), us(t1, t2), us(t2, t3), d == v };
+    } },
+  };
+
+  bool correct = true;
+
+  for (const auto& column : columns) {
+    const auto& v = *column.second;
+
+    const bool sortedUnique = std::adjacent_find(v.begin(), v.end(),
+      [](uint32_t l, uint32_t r) { return l >= r; }) == v.end();
+
+    std::cout << "* " << column.first << " [" << v.size() << " values]" << std::endl;
+
+    for (const auto& codec : codecs) {
+      std::cout << std::setw(18) << codec.first << ":\t";
+
+      if (v.empty() || (codec.first == "Postings" && !sortedUnique)) {
+        std::cout << "-" << std::endl;
+        continue;
+      }
+
+      auto r = codec.second(v);
+
+      std::cout << std::fixed << std::setprecision(2) 
+        << (double)r.bits / v.size() << " bit per value,\t"
+        << "encode " << r.encode << ",\tdecode " << r.decode 
+        << std::defaultfloat << std::endl;
+
+      if (!r.same) {
+        std::cout << "Different values: " << codec.first << " on " << column.first << std::endl;
+        correct = false;
+      }
+    }
+
+    std::cout << std::endl;
+  }
+
+  return correct;
+}
+
+
+/**
+* Arguments are real column samples to replay in the codec matrix,
+* raw uint32 files.
+*/
+int main(int argc, char** argv)
+{
+  auto gt1 = std::chrono::high_resolution_clock::now();
+  auto td1 = generateTestData(10'000'000,  
+    std::cauchy_distribution<>{4.0, 2.0}, 1);
+  auto td2 = generateTestData(10'000'000,
+    std::cauchy_distribution<>{8.0, 8.0}, 2);
+  auto td3 = generateTestData(10'000'000,
+    std::cauchy_distribution<>{8.0, 16.0}, 3);
+  auto td4 = generateTestData(10'000'000,
+    std::cauchy_distribution<>{16.0, 16.0}, 4);
+  auto td5 = generateTestData(10'000'000,
+    std::cauchy_distribution<>{1000.0, 1000.0}, 5);
+
+  // shapes of production columns
+  auto zipfKeys = testData::zipf(10'000'000, 1 << 20, 1.1, 6);
+  auto counts = testData::burstyCounts(10'000'000, 7);
+  auto seconds = testData::timestamps<uint32_t>(10'000'000, 1'600'000'000, 10, 10, 8);
+  auto sparseIds = testData::sparseIds(10'000'000, 64, 9);
+  auto sizes = testData::mixedSizes(10'000'000, 10);
+
+  std::vector<std::pair<std::string, std::vector<uint32_t>>> samples;
+  for (int a = 1; a < argc; ++a) {
+    samples.emplace_back(argv[a], testData::replayColumn(argv[a]));
+  }
+  auto gt2 = std::chrono::high_resolution_clock::now();
+
+  std::cout << "Test data generated in " 
+    << std::chrono::duration_cast<std::chrono::milliseconds>(gt2 - gt1).count() 
+    << " ms" << std::endl;
+
+  std::cout << " ** CHECKING TEST DATA REPRODUCIBILITY ** " << std::endl;
+  {
+    // same seed, one thread against all of them
+    auto serial = generateTestData(td1.size(), std::cauchy_distribution<>{4.0, 2.0}, 1, 1);
+
+    if (serial != td1) {
+      std::cout << "Different test data for the same seed" << std::endl;
+    }
+    else {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+  }
+
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+  std::cout << " ** Compressing ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+
+  std::cout << " ** CHECKING CRC32C ** " << std::endl;
+  {
+    // 0xE3069283 - standard check value of "123456789"
+    // split in the middle of a stripe, so both paths are chained
+    auto whole = crc32c(td1.data(), td1.size() * 4);
+    auto head = crc32c(td1.data(), 1001);
+    auto chained = crc32c(reinterpret_cast<const uint8_t*>(td1.data()) + 1001, 
+      td1.size() * 4 - 1001, head);
+
+    if (crc32c("123456789", 9) != 0xE3069283 || whole != chained) {
+      std::cout << "Wrong checksum" << std::endl;
+    }
+    else {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+  }
+
+  std::cout << std::endl;
+
+  // persisted columns go to the temp directory, not to the working one
+  const auto tmp = std::filesystem::temp_directory_path();
+  const std::string columnPath = (tmp / "column.itc").string();
+  const std::string badColumnPath = (tmp / "column.bad.itc").string();
+
+  // caller owned output for the allocation free encoder, reused by all runs
+  std::vector<uint32_t> arena(Compressed::max_encoded_words(td1.size()));
+
+  // decode buffers survive between runs
+  DecodeBufferPool pool;
+
+  for (const auto* const td : 
+    std::vector<const decltype(td1)*>{ 
+            &td1, &td2, &td3, &td4, &td5 
+    }) {
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Compressed cd(*td);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto abits = Compressed::encode(td->data(), td->size(), arena.data());
+    t2 = std::chrono::high_resolution_clock::now();
+    auto act = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "* Original:\t";
+    std::cout << "[\t" 
+      << td1.size() * 32 << " bit,\t"
+      << td1.size() * 4 << " b,\t"
+      << td1.size() / 256 << " Kb]"
+      << std::endl;
+
+
+    std::cout << "* Compressed:\t";
+    std::cout << "[\t"
+      << cd.bits() << " bit,\t"
+      << cd.bits() / 8 << " b,\t"
+      << cd.bits() / 8'192 << " Kb] "
+      << std::endl;
+
+    /*
+
+    snappy compression
+
+    */
+    std::string snappy_compressed;
+
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto csize = snappy::Compress(reinterpret_cast<const char*>(&(*td->begin())), td->size() * 4, &snappy_compressed);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto sct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "* Snappy:\t";
+    std::cout << "[\t"
+      << csize * 8 << " bit,\t"
+      << csize << " b,\t"
+      << csize / 1024 << " Kb]"
+      << std::endl;
+
+    std::cout << std::endl;
+
+    std::cout << "       Compression time:\t\t" << ct << std::endl;
+    std::cout << " Arena compression time:\t\t" << act << std::endl;
+    std::cout << "Snappy compression time:\t\t" << sct << std::endl;
+    std::cout << std::endl;
+
+
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto dd = cd.decompress();
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto ddo = cd.decompress_optimized();
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto odt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+
+    // convert after decode vs converted while decoding
+    t1 = std::chrono::high_resolution_clock::now();
+    auto wide2 = cd.decompress_optimized();
+    std::vector<uint64_t> wide(wide2.begin(), wide2.end());
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto w2t = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto wide1 = cd.decompress_as(DecodeAsU64());
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto w1t = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    const double scale = 0.001;
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto scaled2 = cd.decompress_optimized();
+    std::vector<double> scaled(scaled2.size());
+    std::transform(scaled2.begin(), scaled2.end(), scaled.begin(),
+      [scale](uint32_t v) { return v * scale; });
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto s2t = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto scaled1 = cd.decompress_as(DecodeScaled<double>{ scale });
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto s1t = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    auto floats = cd.decompress_as(DecodeScaled<float>{ 0.5f });
+
+
+    std::vector<uint32_t> cdo;
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto cstatus = cd.decompress_checked(cdo);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto cdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    // first decode fills the pool, timed one reuses the buffer
+    pool.release(cd.decompress_optimized(pool));
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto pdo = cd.decompress_optimized(pool);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto pdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+
+    // persisted column, decoded from mapped pages
+    cd.save(columnPath, 4096, true);
+
+    t1 = std::chrono::high_resolution_clock::now();
+    MappedCompressed mc(columnPath);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto mot = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto mdo = mc.decompress_optimized();
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto mdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::vector<uint32_t> mvo(td->size());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto verified = mc.decompress_verified(mvo.data());
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto mvt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::vector<uint32_t> mbo(td->size());
+    for (size_t b = 0; b < mc.blocks(); ++b) {
+      mc.decode_block(b, mbo.data() + b * mc.block_size());
+    }
+
+
+    // compaction: splice parts instead of decode and encode
+    std::vector<Compressed> parts;
+    for (size_t p = 0; p < 8; ++p) {
+      parts.emplace_back(std::vector<uint32_t>(
+        td->begin() + td->size() * p / 8, 
+        td->begin() + td->size() * (p + 1) / 8));
+    }
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto merged = Compressed::concat(parts.data(), parts.size());
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto mgt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    Compressed appended = parts[0];
+    appended.append(parts[1]);
+
+    // lazy view, bounded memory
+    CompressedView view(cd);
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto vsum = std::accumulate(view.begin(), view.end(), 0ull);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto vat = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+
+    std::vector<uint32_t> sd(td->size());
+    std::string uncompressed;
+
+    t1 = std::chrono::high_resolution_clock::now();
+    snappy::Uncompress(
+      snappy_compressed.c_str(), 
+      csize, 
+      &uncompressed);
+    t2 = std::chrono::high_resolution_clock::now();
+
+    auto sdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    memcpy(&(*sd.begin()), uncompressed.c_str(), td->size() * 4);
+
+
+
+
+    std::cout << "    Decompression time:\t\t" << dt << std::endl;
+    std::cout << "   Opt decompress time:\t\t" << odt << std::endl;
+    std::cout << "Checked decompress time:\t\t" << cdt << std::endl;
+    std::cout << "  Pool decompress time:\t\t" << pdt << std::endl;
+    std::cout << "Decompress+u64 2 pass:\t\t" << w2t << std::endl;
+    std::cout << "  Decompress as u64 time:\t\t" << w1t << std::endl;
+    std::cout << "Decompress+scale 2 pass:\t\t" << s2t << std::endl;
+    std::cout << "Decompress scaled time:\t\t" << s1t << std::endl;
+    std::cout << "       Concat 8 time:\t\t" << mgt << std::endl;
+    std::cout << "  View accumulate time:\t\t" << vat << std::endl;
+    std::cout << "       Mapped open time:\t\t" << mot << std::endl;
+    std::cout << "Mapped decompress time:\t\t" << mdt << std::endl;
+    std::cout << "  CRC verify+decompress:\t\t" << mvt << std::endl;
+    std::cout << "Snappy decompress time:\t\t" << sdt << std::endl;
+
+
+    std::cout << "    Optimization boost:\t\t" << (dt - odt) * 100.0 / dt 
+      << " % " << std::endl;
+
+    std::cout << std::endl;
+
+
+    std::cout << std::endl;
+
+    std::cout << " ** CHECKING CORRECTNESS ** " << std::endl;
+    testEqual(*td, dd);
+
+    std::cout << " ** CHECKING OPTIMIZED CORRECTNESS ** " << std::endl;
+    testEqual(*td, ddo);
+
+    std::cout << " ** CHECKING CHECKED CORRECTNESS ** " << std::endl;
+    if (cstatus != DecodeStatus::Ok) {
+      std::cout << "Checked decode failed" << std::endl;
+    }
+    testEqual(*td, cdo);
+
+    std::cout << " ** CHECKING TRUNCATED INPUT ** " << std::endl;
+    {
+      // status instead of reading past the end
+      const auto& words = cd.data();
+      auto truncated = Compressed::decode_checked(
+        words.data(), words.size() / 2, cd.digits(), cd.bits(), cdo.data());
+      auto shortened = Compressed::decode_checked(
+        words.data(), words.size(), cd.digits() + 100, cd.bits(), cdo.data());
+
+      if (truncated != DecodeStatus::Truncated || shortened == DecodeStatus::Ok) {
+        std::cout << "Broken input is not detected" << std::endl;
+      }
+      else {
+        std::cout << " * | Everything is correct | * " << std::endl;
+      }
+    }
+
+    std::cout << " ** CHECKING POOL CORRECTNESS ** " << std::endl;
+    testEqual(*td, pdo);
+
+    std::cout << " ** CHECKING CONVERTED CORRECTNESS ** " << std::endl;
+    {
+      // bit identical: same conversion and rounding in both paths
+      bool same = wide1 == wide && scaled1 == scaled && floats.size() == td->size();
+      for (size_t i = 0; same && i < floats.size(); ++i) {
+        same = floats[i] == (float)(*td)[i] * 0.5f;
+      }
+
+      if (!same) {
+        std::cout << "Converted values are Different" << std::endl;
+      }
+      else {
+        std::cout << " * | Everything is correct | * " << std::endl;
+      }
+    }
+    pool.release(std::move(pdo));
+
+    std::cout << " ** CHECKING CONCAT ** " << std::endl;
+    {
+      // concatenated streams must be bit exact copy of whole encode
+      Compressed half(std::vector<uint32_t>(
+        td->begin(), td->begin() + td->size() * 2 / 8));
+
+      if (merged.bits() != cd.bits() || merged.digits() != cd.digits() ||
+        merged.data() != cd.data() ||
+        appended.bits() != half.bits() || appended.data() != half.data()) {
+        std::cout << "Different stream" << std::endl;
+      }
+      else {
+        std::cout << " * | Everything is correct | * " << std::endl;
+      }
+    }
+
+    std::cout << " ** CHECKING VIEW CORRECTNESS ** " << std::endl;
+    if (vsum != std::accumulate(td->begin(), td->end(), 0ull) ||
+      view.misses() != (td->size() + 1023) / 1024 ||
+      !std::equal(view.begin(), view.end(), td->begin()) ||
+      view[td->size() / 3] != (*td)[td->size() / 3]) {
+      std::cout << "Different view values" << std::endl;
+    }
+    else {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " ** CHECKING MAPPED CORRECTNESS ** " << std::endl;
+    testEqual(*td, mdo);
+
+    std::cout << " ** CHECKING MAPPED BLOCKS CORRECTNESS ** " << std::endl;
+    testEqual(*td, mbo);
+
+    std::cout << " ** CHECKING VERIFIED CORRECTNESS ** " << std::endl;
+    if (!verified) {
+      std::cout << "Checksum mismatch" << std::endl;
+    }
+    testEqual(*td, mvo);
+
+    std::cout << " ** CHECKING CORRUPTION DETECTION ** " << std::endl;
+    {
+      std::ifstream in(columnPath, std::ios::binary);
+      std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      bytes[sizeof(CompressedFileHeader) + bytes.size() / 2] ^= 0x10;
+      std::ofstream(badColumnPath, std::ios::binary) << bytes;
+    }
+
+    if (MappedCompressed(badColumnPath).verify()) {
+      std::cout << "Bit flip is not detected" << std::endl;
+    }
+    else {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " ** CHECKING FORGED CHECKSUM COUNT ** " << std::endl;
+    {
+      // no index, checksum count whose byte size wraps to 0, footer moved to match
+      Compressed(std::vector<uint32_t>(td->begin(), td->begin() + 1000)).save(badColumnPath, 0, true);
+
+      std::ifstream in(badColumnPath, std::ios::binary);
+      std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      in.close();
+
+      auto* h = reinterpret_cast<CompressedFileHeader*>(&bytes[0]);
+      h->index_blocks = 1ull << 62;
+
+      CompressedFileFooter footer{};
+      footer.file_size = sizeof(CompressedFileHeader) + alignUp(h->words * sizeof(uint32_t)) + 
+        sizeof(CompressedFileFooter);
+      memcpy(footer.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+
+      bytes.resize(footer.file_size - sizeof(footer));
+      bytes.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+      std::ofstream(badColumnPath, std::ios::binary) << bytes;
+    }
+
+    try {
+      MappedCompressed forged(badColumnPath);
+      std::cout << "Forged checksum count not detected" << std::endl;
+    }
+    catch (const std::runtime_error&) {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " ** CHECKING ARENA ENCODER ** " << std::endl;
+    if (abits != cd.bits() ||
+      !std::equal(arena.begin(), arena.begin() + (abits + 31) / 32, cd.data().begin())) {
+      std::cout << "Different encoding" << std::endl;
+    }
+    else {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " ** CHECKING SNAPPY CORRECTNESS ** " << std::endl;
+    testEqual(*td, sd);
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+
+
+  std::cout << " ** Codec matrix ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    std::vector<std::pair<std::string, const std::vector<uint32_t>*>> columns{
+      { "Cauchy 4/2", &td1 },
+      { "Cauchy 8/8", &td2 },
+      { "Cauchy 8/16", &td3 },
+      { "Cauchy 16/16", &td4 },
+      { "Cauchy 1000/1000", &td5 },
+      { "Zipf keys", &zipfKeys },
+      { "Bursty counts", &counts },
+      { "Timestamps", &seconds },
+      { "Sparse IDs", &sparseIds },
+      { "Mixed sizes", &sizes },
+    };
+
+    for (const auto& sample : samples) {
+      columns.emplace_back("Sample " + sample.first, &sample.second);
+    }
+
+    auto correct = runCodecMatrix(columns);
+
+    std::cout << " ** CHECKING CODEC MATRIX CORRECTNESS ** " << std::endl;
+    if (correct) {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::cout << " ** Short series ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> len(50, 500);
+
+    std::vector<uint32_t> lengths;
+    for (size_t total = 0; total < td1.size();) {
+      lengths.push_back(std::min<uint32_t>(len(gen), td1.size() - total));
+      total += lengths.back();
+    }
+
+    std::vector<size_t> ids(lengths.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+      ids[i] = i;
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::vector<Compressed> single;
+    single.reserve(lengths.size());
+    for (size_t i = 0, first = 0; i < lengths.size(); first += lengths[i++]) {
+      single.emplace_back(std::vector<uint32_t>(
+        td1.begin() + first, td1.begin() + first + lengths[i]));
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto sct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
     t1 = std::chrono::high_resolution_clock::now();
-    snappy::Uncompress(
-      snappy_compressed.c_str(), 
-      csize, 
-      &uncompressed);
+    CompressedBatch batch(td1.data(), lengths.data(), lengths.size());
     t2 = std::chrono::high_resolution_clock::now();
+    auto bct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
+    std::vector<uint32_t> sd;
+    sd.reserve(td1.size());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    for (const auto& c : single) {
+      auto d = c.decompress_optimized();
+      sd.insert(sd.end(), d.begin(), d.end());
+    }
+    t2 = std::chrono::high_resolution_clock::now();
     auto sdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
-    memcpy(&(*sd.begin()), uncompressed.c_str(), td->size() * 4);
+    std::vector<uint32_t> bd(batch.decoded_size(ids.data(), ids.size()) + DECODE_SLACK);
+
+    t1 = std::chrono::high_resolution_clock::now();
+    bd.resize(batch.decode(ids.data(), ids.size(), bd.data()));
+    t2 = std::chrono::high_resolution_clock::now();
+    auto bdt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "Series:\t\t" << lengths.size() << std::endl;
+    std::cout << "* Batch:\t[\t" << batch.bits() << " bit]" << std::endl;
+    std::cout << std::endl;
+    std::cout << " Single compression time:\t\t" << sct << std::endl;
+    std::cout << "  Batch compression time:\t\t" << bct << std::endl;
+    std::cout << " Single decompress time:\t\t" << sdt << std::endl;
+    std::cout << "  Batch decompress time:\t\t" << bdt << std::endl;
+    std::cout << std::endl;
+
+    std::cout << " ** CHECKING SINGLE CORRECTNESS ** " << std::endl;
+    testEqual(td1, sd);
+
+    std::cout << " ** CHECKING BATCH CORRECTNESS ** " << std::endl;
+    testEqual(td1, bd);
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::cout << " ** Timestamps ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    // 1s interval in ns, every 100th point is off by up to 1us
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int64_t> jitter(-1000, 1000);
+
+    std::vector<uint64_t> ts(td1.size());
+    uint64_t t = 1'600'000'000'000'000'000ull;
+    for (size_t i = 0; i < ts.size(); ++i) {
+      t += 1'000'000'000ull;
+      ts[i] = i % 100 == 0 ? t + jitter(gen) : t;
+    }
 
+    auto t1 = std::chrono::high_resolution_clock::now();
+    CompressedTimestamps cts(ts);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
+    t1 = std::chrono::high_resolution_clock::now();
+    auto dd = cts.decompress();
+    t2 = std::chrono::high_resolution_clock::now();
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
+    t1 = std::chrono::high_resolution_clock::now();
+    auto ddo = cts.decompress_optimized();
+    t2 = std::chrono::high_resolution_clock::now();
+    auto odt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
+    std::cout << "* Original:\t[\t" << ts.size() * 64 << " bit]" << std::endl;
+    std::cout << "* Compressed:\t[\t" << cts.bits() << " bit,\t"
+      << (double)cts.bits() / ts.size() << " bit per value]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "       Compression time:\t\t" << ct << std::endl;
     std::cout << "    Decompression time:\t\t" << dt << std::endl;
     std::cout << "   Opt decompress time:\t\t" << odt << std::endl;
-    std::cout << "Snappy decompress time:\t\t" << sdt << std::endl;
+    std::cout << std::endl;
 
+    std::cout << " ** CHECKING CORRECTNESS ** " << std::endl;
+    testEqual(ts, dd);
 
-    std::cout << "    Optimization boost:\t\t" << (dt - odt) * 100.0 / dt 
-      << " % " << std::endl;
+    std::cout << " ** CHECKING OPTIMIZED CORRECTNESS ** " << std::endl;
+    testEqual(ts, ddo);
 
+    std::cout << " _______ " << std::endl;
     std::cout << std::endl;
+  }
+
+  std::cout << " ** Floats ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    // gauge with 2 decimal digits
+    std::vector<double> dv(td1.size());
+    std::vector<float> fv(td1.size());
+    for (size_t i = 0; i < td1.size(); ++i) {
+      dv[i] = td1[i] / 100.0;
+      fv[i] = (float)dv[i];
+    }
+
+    // repeated readings are common in metrics
+    for (size_t i = 1; i < td1.size(); i += 3) {
+      dv[i] = dv[i - 1];
+      fv[i] = fv[i - 1];
+    }
 
+    auto t1 = std::chrono::high_resolution_clock::now();
+    CompressedDoubles cdv(dv);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ct = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto dd = cdv.decompress();
+    t2 = std::chrono::high_resolution_clock::now();
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    auto ddo = cdv.decompress_optimized();
+    t2 = std::chrono::high_resolution_clock::now();
+    auto odt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    CompressedFloats<float> cfv(fv);
+    auto fdo = cfv.decompress_optimized();
 
+    std::cout << "* Doubles:\t[\t" << dv.size() * 64 << " bit]" << std::endl;
+    std::cout << "* Compressed:\t[\t" << cdv.bits() << " bit,\t"
+      << (double)cdv.bits() / dv.size() << " bit per value]" << std::endl;
+    std::cout << "* Floats:\t[\t" << fv.size() * 32 << " bit]" << std::endl;
+    std::cout << "* Compressed:\t[\t" << cfv.bits() << " bit,\t"
+      << (double)cfv.bits() / fv.size() << " bit per value]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "       Compression time:\t\t" << ct << std::endl;
+    std::cout << "    Decompression time:\t\t" << dt << std::endl;
+    std::cout << "   Opt decompress time:\t\t" << odt << std::endl;
     std::cout << std::endl;
 
     std::cout << " ** CHECKING CORRECTNESS ** " << std::endl;
-    testEqual(*td, dd);
+    testEqual(dv, dd);
 
     std::cout << " ** CHECKING OPTIMIZED CORRECTNESS ** " << std::endl;
-    testEqual(*td, ddo);
+    testEqual(dv, ddo);
 
-    std::cout << " ** CHECKING SNAPPY CORRECTNESS ** " << std::endl;
-    testEqual(*td, sd);
+    std::cout << " ** CHECKING FLOAT CORRECTNESS ** " << std::endl;
+    testEqual(fv, fdo);
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::cout << " ** Postings ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    std::mt19937 gen(13);
+
+    // sorted unique ids, every 1 of `sparsity` from [0, n * sparsity)
+    auto ids = [&](size_t n, uint32_t sparsity) {
+      std::uniform_int_distribution<uint32_t> d(1, 2 * sparsity - 1);
+      std::vector<uint32_t> res(n);
+      uint32_t v = 0;
+      for (auto& r : res) {
+        v += d(gen);
+        r = v;
+      }
+      return res;
+    };
+
+    auto large = ids(10'000'000, 4);
+    auto medium = ids(8'000'000, 5);
+    auto small = ids(10'000, 4'000);
+
+    CompressedPostings pl(large);
+    CompressedPostings pm(medium);
+    CompressedPostings ps(small);
+
+    std::cout << "* Large:\t[\t" << large.size() * 32 << " bit]" << std::endl;
+    std::cout << "* Compressed:\t[\t" << pl.bits() << " bit]" << std::endl;
+    std::cout << std::endl;
+
+    for (const auto& c : std::vector<std::vector<const std::vector<uint32_t>*>>{
+      { &large, &medium }, { &large, &small }, { &large, &medium, &small } }) {
+
+      std::vector<uint32_t> expected = *c[0];
+      std::vector<const CompressedPostings*> lists;
+      for (const auto* l : c) {
+        std::vector<uint32_t> tmp;
+        std::set_intersection(expected.begin(), expected.end(), l->begin(), l->end(), 
+          std::back_inserter(tmp));
+        expected.swap(tmp);
+
+        lists.push_back(l == &large ? &pl : l == &medium ? &pm : &ps);
+      }
+
+      auto t1 = std::chrono::high_resolution_clock::now();
+      auto res = intersect(lists);
+      auto t2 = std::chrono::high_resolution_clock::now();
+      auto it = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+      std::cout << lists.size() << " lists, smallest " << c.back()->size() 
+        << ", intersection time:\t\t" << it << std::endl;
+
+      std::cout << " ** CHECKING INTERSECTION CORRECTNESS ** " << std::endl;
+      testEqual(expected, res);
+    }
+
+    std::cout << " ** CHECKING POSTINGS CORRECTNESS ** " << std::endl;
+    testEqual(large, pl.decompress());
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::cout << " ** Large output ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    // hot working set of a co-located stage, should survive the decode
+    Compressed cd(td1);
+    std::vector<uint64_t> probe((4 << 20) / sizeof(uint64_t), 1);
+    LlcMissCounter misses;
+
+    // probe sums go here, so the re-reads are not optimized away
+    volatile uint64_t probeSink = 0;
+
+    HugePageMemory huge(cd.digits() * sizeof(uint32_t));
+    std::vector<uint32_t> plain(cd.digits());
+    auto* hp = huge.as<uint32_t>();
+
+    // fault pages in, first touch is not what is measured
+    std::fill(hp, hp + cd.digits(), 0u);
+
+    auto run = [&](const char* name, uint32_t* out, bool streaming) {
+      auto sum = std::accumulate(probe.begin(), probe.end(), 0ull);
+
+      auto m0 = misses.read();
+      auto t1 = std::chrono::high_resolution_clock::now();
+      if (streaming) {
+        Compressed::decode_streaming(cd.data().data(), cd.digits(), out);
+      }
+      else {
+        Compressed::decode_optimized(cd.data().data(), cd.digits(), out);
+      }
+      auto t2 = std::chrono::high_resolution_clock::now();
+      auto m1 = misses.read();
+
+      sum += std::accumulate(probe.begin(), probe.end(), 0ull);
+      auto m2 = misses.read();
+
+      auto t = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+      std::cout << name << "\t\t" << t;
+      if (misses.available()) {
+        std::cout << "\tLLC misses: decode " << m1 - m0 
+          << ", probe after " << m2 - m1;
+      }
+      std::cout << std::endl;
+
+      probeSink = sum;
+
+      return t;
+    };
+
+    run("   Regular stores:", plain.data(), false);
+    run(" Streaming stores:", plain.data(), true);
+    run("Regular, huge pages:", hp, false);
+    run("Streaming, huge pages:", hp, true);
+
+    if (!misses.available()) {
+      std::cout << "(LLC misses are reported on Linux with perf events only)" << std::endl;
+    }
+
+    std::cout << std::endl;
+
+    auto large = cd.decompress_large();
+
+    std::cout << " ** CHECKING STREAMING CORRECTNESS ** " << std::endl;
+    testEqual(td1, std::vector<uint32_t>(hp, hp + cd.digits()));
+
+    std::cout << " ** CHECKING LARGE OUTPUT CORRECTNESS ** " << std::endl;
+    testEqual(td1, std::vector<uint32_t>(large.as<uint32_t>(), 
+      large.as<uint32_t>() + cd.digits()));
+
+    std::cout << " ** CHECKING UNALIGNED STREAMING ** " << std::endl;
+    {
+      // head before the first 64 byte boundary and short tail
+      std::vector<uint32_t> part(td1.begin(), td1.begin() + 100'003);
+      Compressed cp(part);
+      std::vector<uint32_t> out(part.size() + 16);
+      Compressed::decode_streaming(cp.data().data(), part.size(), out.data() + 3);
+      testEqual(part, std::vector<uint32_t>(out.begin() + 3, out.begin() + 3 + part.size()));
+    }
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::cout << " ** Shared memory ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    // writer and reader would be different processes
+    Compressed cd(td1);
+    const std::string name = "intritest_column";
+
+    SharedMemory::remove(name);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    SharedMemory segment(name, cd.layout_size(4096, true));
+    cd.write_layout(segment.data(), 4096, true);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto wt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    SharedCompressed reader(name);
+    t2 = std::chrono::high_resolution_clock::now();
+    auto ot = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::vector<uint32_t> sd(td1.size());
+    t1 = std::chrono::high_resolution_clock::now();
+    auto verified = reader.decompress_verified(sd.data());
+    t2 = std::chrono::high_resolution_clock::now();
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "* Segment:\t[\t" << segment.size() << " b]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "       Publish time:\t\t" << wt << std::endl;
+    std::cout << "   Reader open time:\t\t" << ot << std::endl;
+    std::cout << "Verified decompress time:\t\t" << dt << std::endl;
+    std::cout << std::endl;
+
+    std::cout << " ** CHECKING SHARED CORRECTNESS ** " << std::endl;
+    if (!verified) {
+      std::cout << "Checksum mismatch" << std::endl;
+    }
+    testEqual(td1, sd);
+
+    SharedMemory::remove(name);
 
     std::cout << " _______ " << std::endl;
     std::cout << std::endl;
   }
 
+  std::cout << " ** Point updates ** " << std::endl;
+  std::cout << " _______ " << std::endl;
+  std::cout << std::endl;
+
+  {
+    auto expected = td1;
+    MutableColumn column(td1);
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<uint64_t> pos(0, td1.size() - 1);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 10'000; ++i) {
+      auto p = pos(gen);
+      column.set(p, i);
+      expected[p] = i;
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ut = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    auto before = column.decompress();
+
+    t1 = std::chrono::high_resolution_clock::now();
+    column.merge_async();
+    column.set(0, 1);
+    expected[0] = 1;
+    column.wait();
+    t2 = std::chrono::high_resolution_clock::now();
+    auto mt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "10'000 updates time:\t\t" << ut << std::endl;
+    std::cout << "    Merge time:\t\t" << mt << std::endl;
+    std::cout << "Pending after merge:\t\t" << column.pending() << std::endl;
+    std::cout << std::endl;
+
+    before[0] = 1;
+
+    std::cout << " ** CHECKING OVERRIDES CORRECTNESS ** " << std::endl;
+    testEqual(expected, before);
+
+    std::cout << " ** CHECKING MERGED CORRECTNESS ** " << std::endl;
+    testEqual(expected, column.decompress());
+
+    std::cout << " ** CHECKING COMPACTED CORRECTNESS ** " << std::endl;
+    column.merge();
+    testEqual(expected, column.compact().decompress_optimized());
 
+    std::cout << " ** CHECKING OUT OF RANGE UPDATE ** " << std::endl;
+    try {
+      column.set(column.size(), 1);
+      std::cout << "Out of range update not detected" << std::endl;
+    }
+    catch (const std::out_of_range&) {
+      std::cout << " * | Everything is correct | * " << std::endl;
+    }
+
+    std::cout << " _______ " << std::endl;
+    std::cout << std::endl;
+  }
+
+  std::remove(columnPath.c_str());
+  std::remove(badColumnPath.c_str());
 
   return 0;
 }
-
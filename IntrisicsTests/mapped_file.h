@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+* Read only view of the whole file.
+* Opening is O(1): pages are faulted in on first access,
+* nothing is copied into the heap.
+*/
+class MappedFile {
+  const uint8_t* _ptr;
+  size_t _size;
+
+#ifdef _WIN32
+  HANDLE _file;
+  HANDLE _mapping;
+#else
+  int _fd;
+#endif
+
+public:
+  explicit MappedFile(const std::string& path) :
+    _ptr(nullptr),
+    _size(0)
+  {
+#ifdef _WIN32
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    _mapping = nullptr;
+
+    if (_file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("Can't open " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size)) {
+      CloseHandle(_file);
+      throw std::runtime_error("Can't stat " + path);
+    }
+    _size = (size_t)size.QuadPart;
+
+    if (_size > 0) {
+      _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (_mapping == nullptr) {
+        CloseHandle(_file);
+        throw std::runtime_error("Can't map " + path);
+      }
+
+      _ptr = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    _fd = open(path.c_str(), O_RDONLY);
+
+    if (_fd < 0) {
+      throw std::runtime_error("Can't open " + path);
+    }
+
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+      close(_fd);
+      throw std::runtime_error("Can't stat " + path);
+    }
+    _size = (size_t)st.st_size;
+
+    if (_size > 0) {
+      void* p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+      _ptr = p == MAP_FAILED ? nullptr : (const uint8_t*)p;
+    }
+#endif
+
+    if (_size > 0 && _ptr == nullptr) {
+      close_handles();
+      throw std::runtime_error("Can't map " + path);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (_ptr != nullptr) {
+#ifdef _WIN32
+      UnmapViewOfFile(_ptr);
+#else
+      munmap((void*)_ptr, _size);
+#endif
+    }
+
+    close_handles();
+  }
+
+  const uint8_t* data() const {
+    return _ptr;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+  /**
+  * Hint for one front to back pass: aggressive read-ahead
+  */
+  void advise_sequential() const {
+#ifndef _WIN32
+    if (_ptr != nullptr) {
+      madvise((void*)_ptr, _size, MADV_SEQUENTIAL);
+    }
+#endif
+  }
+
+  /**
+  * Drop already processed pages from the working set, so resident
+  * memory of a scan doesn't grow with the file. offset must be
+  * page aligned. Pages stay in the page cache.
+  */
+  void release(size_t offset, size_t size) const {
+    if (_ptr == nullptr || offset >= _size) {
+      return;
+    }
+
+    size = std::min(size, _size - offset);
+
+#ifdef _WIN32
+    // unlocking pages that are not locked removes them from working set
+    VirtualUnlock((void*)(_ptr + offset), size);
+#else
+    madvise((void*)(_ptr + offset), size, MADV_DONTNEED);
+#endif
+  }
+
+private:
+  void close_handles() {
+#ifdef _WIN32
+    if (_mapping != nullptr) {
+      CloseHandle(_mapping);
+    }
+    CloseHandle(_file);
+#else
+    close(_fd);
+#endif
+  }
+};
+
+/**
+* Named shared memory segment.
+* Writer creates it with size and fills data(), readers open it
+* by name read only. Segment is position independent, readers
+* may map it at any address. Name is not removed on destruction,
+* call remove() when column is retired (no-op on Windows, where
+* segment lives while any handle is open).
+*/
+class SharedMemory {
+  uint8_t* _ptr;
+  size_t _size;
+
+#ifdef _WIN32
+  HANDLE _mapping;
+
+  static std::string systemName(const std::string& name) {
+    return "Local\\" + name;
+  }
+#else
+  static std::string systemName(const std::string& name) {
+    return "/" + name;
+  }
+#endif
+
+public:
+  // create for writing
+  SharedMemory(const std::string& name, size_t size) :
+    _ptr(nullptr),
+    _size(size)
+  {
+#ifdef _WIN32
+    _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+      (DWORD)((uint64_t)size >> 32), (DWORD)size, systemName(name).c_str());
+
+    if (_mapping == nullptr || GetLastError() == ERROR_ALREADY_EXISTS) {
+      if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+      }
+      throw std::runtime_error("Can't create shared memory " + name);
+    }
+
+    _ptr = (uint8_t*)MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+#else
+    int fd = shm_open(systemName(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Can't create shared memory " + name);
+    }
+
+    if (ftruncate(fd, (off_t)size) == 0) {
+      void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      _ptr = p == MAP_FAILED ? nullptr : (uint8_t*)p;
+    }
+
+    close(fd);
+#endif
+
+    if (_ptr == nullptr) {
+      release();
+      remove(name);
+      throw std::runtime_error("Can't map shared memory " + name);
+    }
+  }
+
+  // open read only
+  explicit SharedMemory(const std::string& name) :
+    _ptr(nullptr),
+    _size(0)
+  {
+#ifdef _WIN32
+    _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, systemName(name).c_str());
+    if (_mapping == nullptr) {
+      throw std::runtime_error("Can't open shared memory " + name);
+    }
+
+    _ptr = (uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+
+    // page rounded, readers must not rely on exact size
+    MEMORY_BASIC_INFORMATION info;
+    if (_ptr != nullptr && VirtualQuery(_ptr, &info, sizeof(info)) != 0) {
+      _size = info.RegionSize;
+    }
+#else
+    int fd = shm_open(systemName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("Can't open shared memory " + name);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      _size = (size_t)st.st_size;
+      void* p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+      _ptr = p == MAP_FAILED ? nullptr : (uint8_t*)p;
+    }
+
+    close(fd);
+#endif
+
+    if (_ptr == nullptr) {
+      release();
+      throw std::runtime_error("Can't map shared memory " + name);
+    }
+  }
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  ~SharedMemory() {
+    release();
+  }
+
+  uint8_t* data() {
+    return _ptr;
+  }
+
+  const uint8_t* data() const {
+    return _ptr;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+  static void remove(const std::string& name) {
+#ifndef _WIN32
+    shm_unlink(systemName(name).c_str());
+#endif
+  }
+
+private:
+  void release() {
+#ifdef _WIN32
+    if (_ptr != nullptr) {
+      UnmapViewOfFile(_ptr);
+    }
+    if (_mapping != nullptr) {
+      CloseHandle(_mapping);
+    }
+#else
+    if (_ptr != nullptr) {
+      munmap(_ptr, _size);
+    }
+#endif
+    _ptr = nullptr;
+  }
+};
+
+/**
+* Anonymous memory for very large buffers.
+* Linux: 2 MB aligned mapping with MADV_HUGEPAGE, so transparent huge
+* pages back it and a 40 MB decode output needs 20 TLB entries
+* instead of 10000. Windows: plain VirtualAlloc, large pages need
+* SeLockMemoryPrivilege which benchmarks usually don't have.
+* Not initialized, pages are faulted in on first write.
+*/
+class HugePageMemory {
+  uint8_t* _ptr;
+  size_t _size;
+  size_t _mapped;
+
+public:
+  static constexpr size_t HUGE_PAGE = 2 << 20;
+
+  explicit HugePageMemory(size_t size) :
+    _ptr(nullptr),
+    _size(size),
+    _mapped((size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE)
+  {
+    if (_mapped == 0) {
+      return;
+    }
+
+#ifdef _WIN32
+    _ptr = (uint8_t*)VirtualAlloc(nullptr, _mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    // over map by one huge page and cut unaligned ends off
+    void* p = mmap(nullptr, _mapped + HUGE_PAGE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p != MAP_FAILED) {
+      auto raw = (uintptr_t)p;
+      auto aligned = (raw + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+
+      if (aligned > raw) {
+        munmap(p, aligned - raw);
+      }
+      munmap((void*)(aligned + _mapped), raw + HUGE_PAGE - aligned);
+
+      _ptr = (uint8_t*)aligned;
+#ifdef MADV_HUGEPAGE
+      // only a hint, THP may be disabled
+      madvise(_ptr, _mapped, MADV_HUGEPAGE);
+#endif
+    }
+#endif
+
+    if (_ptr == nullptr) {
+      throw std::runtime_error("Can't allocate " + std::to_string(size) + " bytes");
+    }
+  }
+
+  HugePageMemory(HugePageMemory&& other) noexcept :
+    _ptr(other._ptr),
+    _size(other._size),
+    _mapped(other._mapped)
+  {
+    other._ptr = nullptr;
+  }
+
+  HugePageMemory(const HugePageMemory&) = delete;
+  HugePageMemory& operator=(const HugePageMemory&) = delete;
+  HugePageMemory& operator=(HugePageMemory&&) = delete;
+
+  ~HugePageMemory() {
+    if (_ptr != nullptr) {
+#ifdef _WIN32
+      VirtualFree(_ptr, 0, MEM_RELEASE);
+#else
+      munmap(_ptr, _mapped);
+#endif
+    }
+  }
+
+  template <typename T>
+  T* as() {
+    return reinterpret_cast<T*>(_ptr);
+  }
+
+  template <typename T>
+  const T* as() const {
+    return reinterpret_cast<const T*>(_ptr);
+  }
+
+  size_t size() const {
+    return _size;
+  }
+};
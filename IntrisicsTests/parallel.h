@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+* Work splitting for parallel kernels and test data generation.
+* Callers pass their own minimum part size.
+*/
+namespace parallel {
+  /**
+  * Threads for n elements when every thread must get at least
+  * minPart of them, threads = 0 - hardware concurrency.
+  */
+  inline unsigned threadsFor(size_t n, size_t minPart, unsigned threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return (unsigned)std::max<size_t>(1, std::min<size_t>(threads, n / minPart));
+  }
+
+  /**
+  * Calls part(t, begin, end) for contiguous parts of [0, n), one per
+  * thread, part 0 on the calling thread. Inner borders are multiples
+  * of align: 8 for uint64 keeps 64 byte lines to one thread.
+  */
+  template <typename Part>
+  void split(size_t n, unsigned threads, Part part, size_t align = 1) {
+    threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, n));
+
+    auto border = [&](unsigned t) {
+      return t == threads ? n : n * t / threads / align * align;
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+
+    for (unsigned t = 1; t < threads; ++t) {
+      workers.emplace_back([&, t]() {
+        part(t, border(t), border(t + 1));
+      });
+    }
+
+    part(0u, (size_t)0, border(1));
+
+    for (auto& w : workers) {
+      w.join();
+    }
+  }
+}
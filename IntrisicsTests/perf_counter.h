@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+* Last level cache misses of the calling thread, for benchmarks.
+* Linux only (perf_event_open), available() is false elsewhere or
+* when perf_event_paranoid forbids it, read() returns 0 then.
+* Windows has no unprivileged per-thread PMC API (hardware counters
+* need an admin ETW kernel session or a vendor driver), so the MSVC
+* build reports timings only.
+*/
+class LlcMissCounter {
+  int _fd;
+
+public:
+  LlcMissCounter() :
+    _fd(-1)
+  {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    _fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  LlcMissCounter(const LlcMissCounter&) = delete;
+  LlcMissCounter& operator=(const LlcMissCounter&) = delete;
+
+  ~LlcMissCounter() {
+#if defined(__linux__)
+    if (_fd >= 0) {
+      close(_fd);
+    }
+#endif
+  }
+
+  bool available() const {
+    return _fd >= 0;
+  }
+
+  uint64_t read() const {
+    uint64_t v = 0;
+#if defined(__linux__)
+    if (_fd >= 0 && ::read(_fd, &v, sizeof(v)) != sizeof(v)) {
+      v = 0;
+    }
+#endif
+    return v;
+  }
+};
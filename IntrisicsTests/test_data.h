@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "parallel.h"
+
+/**
+* Reproducible test data.
+* Every random value is a pure function of (seed, stream, index):
+* splitmix64 over a counter, no generator state is carried between
+* elements. Work is split between threads in any way and the output
+* is bit-identical for a given seed, whatever the thread count.
+*/
+namespace testData {
+  constexpr uint64_t DEFAULT_SEED = 0x9E3779B97F4A7C15ull;
+
+  // splitmix64 finalizer, bijective
+  inline uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // [0, 1) with 53 random bits of x
+  inline double toUnit(uint64_t x) {
+    return (double)(x >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // [0, bound) from high 32 bits of x, bound < 2^32, no division
+  inline uint32_t below(uint64_t x, uint32_t bound) {
+    return (uint32_t)(((x >> 32) * bound) >> 32);
+  }
+
+  /**
+  * Counter based generator. Value i of the stream is mix(key + i * gamma),
+  * so at(i) is O(1) for any i and streams with different ids are
+  * independent. Satisfies UniformRandomBitGenerator, usable with
+  * std distributions.
+  */
+  class Stream {
+    static constexpr uint64_t GAMMA = 0x9E3779B97F4A7C15ull;
+
+    uint64_t _key;
+    uint64_t _counter;
+
+  public:
+    using result_type = uint64_t;
+
+    Stream(uint64_t seed, uint64_t stream, uint64_t counter = 0) :
+      _key(mix(seed ^ mix(stream + GAMMA))),
+      _counter(counter)
+    {
+    }
+
+    static constexpr result_type min() {
+      return 0;
+    }
+
+    static constexpr result_type max() {
+      return ~0ull;
+    }
+
+    uint64_t at(uint64_t i) const {
+      return mix(_key + i * GAMMA);
+    }
+
+    result_type operator()() {
+      return at(_counter++);
+    }
+
+    double uniform() {
+      return toUnit((*this)());
+    }
+
+    uint32_t below(uint32_t bound) {
+      return testData::below((*this)(), bound);
+    }
+  };
+
+  // a generator thread gets at least 64K values: generation is
+  // compute bound, unlike the reductions
+  constexpr size_t GENERATE_PART = 1 << 16;
+
+  /**
+  * out[i] = f(i) in parallel. f must depend on i only.
+  */
+  template <typename T, typename F>
+  void parallelFill(T* out, size_t n, F f, unsigned threads = 0) {
+    threads = parallel::threadsFor(n, GENERATE_PART, threads);
+
+    parallel::split(n, threads, [&](unsigned, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        out[i] = f(i);
+      }
+    });
+  }
+
+  /**
+  * Uniformly random permutation of v, in parallel.
+  * Every element gets a random bucket from its index, buckets are
+  * filled in index order (block histograms and prefix sums, then
+  * scatter), then every bucket is Fisher-Yates shuffled with its own
+  * stream. Block and bucket counts don't depend on threads, neither
+  * does the result. Random bucket labels plus uniform shuffle inside
+  * buckets gives a uniform permutation.
+  */
+  template <typename T>
+  void shuffle(std::vector<T>& v, uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    constexpr size_t BUCKETS = 1024;
+    constexpr size_t BLOCK = 1 << 16;
+
+    const size_t n = v.size();
+    const size_t blocks = (n + BLOCK - 1) / BLOCK;
+    const Stream labels(seed, 0);
+
+    auto bucket = [&](size_t i) {
+      return (size_t)below(labels.at(i), (uint32_t)BUCKETS);
+    };
+
+    threads = parallel::threadsFor(n, GENERATE_PART, threads);
+
+    // counts[block * BUCKETS + bucket]
+    std::vector<size_t> counts(blocks * BUCKETS, 0);
+
+    parallel::split(blocks, threads, [&](unsigned, size_t first, size_t last) {
+      for (size_t b = first; b < last; ++b) {
+        auto* c = counts.data() + b * BUCKETS;
+        for (size_t i = b * BLOCK; i < std::min(n, (b + 1) * BLOCK); ++i) {
+          ++c[bucket(i)];
+        }
+      }
+    });
+
+    // bucket major exclusive prefix sum, counts become write offsets
+    std::vector<size_t> starts(BUCKETS + 1);
+    size_t offset = 0;
+    for (size_t k = 0; k < BUCKETS; ++k) {
+      starts[k] = offset;
+      for (size_t b = 0; b < blocks; ++b) {
+        auto c = counts[b * BUCKETS + k];
+        counts[b * BUCKETS + k] = offset;
+        offset += c;
+      }
+    }
+    starts[BUCKETS] = offset;
+
+    std::vector<T> res(n);
+
+    parallel::split(blocks, threads, [&](unsigned, size_t first, size_t last) {
+      for (size_t b = first; b < last; ++b) {
+        auto* c = counts.data() + b * BUCKETS;
+        for (size_t i = b * BLOCK; i < std::min(n, (b + 1) * BLOCK); ++i) {
+          res[c[bucket(i)]++] = std::move(v[i]);
+        }
+      }
+    });
+
+    parallel::split(BUCKETS, threads, [&](unsigned, size_t first, size_t last) {
+      for (size_t k = first; k < last; ++k) {
+        Stream gen(seed, k + 1);
+        auto* it = res.data() + starts[k];
+
+        for (size_t i = starts[k + 1] - starts[k]; i > 1; --i) {
+          std::swap(it[i - 1], it[gen.below((uint32_t)i)]);
+        }
+      }
+    });
+
+    v.swap(res);
+  }
+
+  /**
+  * Inclusive prefix sum in place, in parallel: sums inside fixed
+  * blocks, serial scan of block totals, then totals added back.
+  */
+  template <typename T>
+  void prefixSum(T* v, size_t n, unsigned threads = 0) {
+    constexpr size_t BLOCK = 1 << 16;
+    const size_t blocks = (n + BLOCK - 1) / BLOCK;
+
+    std::vector<T> carry(blocks);
+    threads = parallel::threadsFor(n, GENERATE_PART, threads);
+
+    parallel::split(blocks, threads, [&](unsigned, size_t first, size_t last) {
+      for (size_t b = first; b < last; ++b) {
+        auto end = std::min(n, (b + 1) * BLOCK);
+        for (size_t i = b * BLOCK + 1; i < end; ++i) {
+          v[i] += v[i - 1];
+        }
+        carry[b] = v[end - 1];
+      }
+    });
+
+    T total = 0;
+    for (auto& c : carry) {
+      auto block = c;
+      c = total;
+      total += block;
+    }
+
+    parallel::split(blocks, threads, [&](unsigned, size_t first, size_t last) {
+      for (size_t b = std::max<size_t>(first, 1); b < last; ++b) {
+        for (size_t i = b * BLOCK; i < std::min(n, (b + 1) * BLOCK); ++i) {
+          v[i] += carry[b];
+        }
+      }
+    });
+  }
+
+  /*
+
+  Column shapes for codec benchmarks.
+  All of them are functions of (seed, index), parallel and reproducible.
+
+  */
+
+  /**
+  * Dictionary codes of Zipf distributed keys: code k (0 is the most
+  * frequent) has probability proportional to 1 / (k + 1)^s.
+  * Inverse CDF over a table of keys entries.
+  */
+  inline std::vector<uint32_t> zipf(size_t n, uint32_t keys, double s, 
+    uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    std::vector<double> cdf(keys);
+
+    double sum = 0;
+    for (uint32_t k = 0; k < keys; ++k) {
+      sum += 1.0 / std::pow(k + 1.0, s);
+      cdf[k] = sum;
+    }
+
+    for (auto& c : cdf) {
+      c /= sum;
+    }
+    cdf.back() = 1.0;
+
+    std::vector<uint32_t> res(n);
+    const Stream gen(seed, 0);
+
+    parallelFill(res.data(), n, [&](size_t i) {
+      auto u = toUnit(gen.at(i));
+      return (uint32_t)(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }, threads);
+
+    return res;
+  }
+
+  /**
+  * Event counts per interval: quiet intervals count 0..7, runs of
+  * 256 intervals burst to 10K..100K with probability 1/32.
+  */
+  inline std::vector<uint32_t> burstyCounts(size_t n, 
+    uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    std::vector<uint32_t> res(n);
+    const Stream bursts(seed, 0);
+    const Stream counts(seed, 1);
+
+    parallelFill(res.data(), n, [&](size_t i) {
+      auto x = counts.at(i);
+      return below(bursts.at(i / 256), 32) == 0 ? 10'000 + below(x, 90'000) : below(x, 8);
+    }, threads);
+
+    return res;
+  }
+
+  /**
+  * Regular series start + i * step with every point late by
+  * [0, jitter). Non decreasing while jitter <= step.
+  */
+  template <typename T = uint64_t>
+  std::vector<T> timestamps(size_t n, T start, T step, uint32_t jitter, 
+    uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    std::vector<T> res(n);
+    const Stream gen(seed, 0);
+
+    parallelFill(res.data(), n, [&](size_t i) {
+      return (T)(start + i * step + (jitter > 0 ? below(gen.at(i), jitter) : 0));
+    }, threads);
+
+    return res;
+  }
+
+  /**
+  * Sorted unique IDs, about 1 of every sparsity from [0, n * sparsity).
+  * Gaps are uniform in [1, 2 * sparsity - 1].
+  */
+  inline std::vector<uint32_t> sparseIds(size_t n, uint32_t sparsity, 
+    uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    std::vector<uint32_t> res(n);
+    const Stream gen(seed, 0);
+
+    parallelFill(res.data(), n, [&](size_t i) {
+      return 1 + below(gen.at(i), 2 * sparsity - 1);
+    }, threads);
+
+    prefixSum(res.data(), n, threads);
+    return res;
+  }
+
+  /**
+  * Object sizes in bytes: 63 of 64 are small (1..512), the rest
+  * are huge (1 MB..1 GB).
+  */
+  inline std::vector<uint32_t> mixedSizes(size_t n, 
+    uint64_t seed = DEFAULT_SEED, unsigned threads = 0) {
+    std::vector<uint32_t> res(n);
+    const Stream gen(seed, 0);
+
+    parallelFill(res.data(), n, [&](size_t i) {
+      auto x = gen.at(i);
+      return (x & 63) == 0 ? (1u << 20) + below(x, 1u << 30) : 1 + below(x, 512);
+    }, threads);
+
+    return res;
+  }
+
+  /**
+  * Real column sample: raw little endian uint32 values, as dumped
+  * from a production column.
+  */
+  inline std::vector<uint32_t> replayColumn(const std::string& path) {
+    MappedFile file(path);
+
+    if (file.size() % sizeof(uint32_t) != 0) {
+      throw std::runtime_error(path + " is not a uint32 column");
+    }
+
+    std::vector<uint32_t> res(file.size() / sizeof(uint32_t));
+    if (!res.empty()) {
+      memcpy(res.data(), file.data(), file.size());
+    }
+
+    return res;
+  }
+}